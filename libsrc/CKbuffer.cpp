@@ -8,37 +8,195 @@
 #include <stdio.h>
 #include "ComboBuffer.h"
 #include "utilsParse.h"
+#include "ColorQuantize.h"
+#include "utilsOptions.h"
+#include "utilsThread.h"
+#include "OutputThread.h"
+#include <string.h>
+#include <stdlib.h>
 
 //---------------------------------------------------------------------
-// KiNET utilities
+// CKpacket
 //---------------------------------------------------------------------
-// Returns the number of bytes copied or a negative number if there wasn't enough room.
-int CopyColorsToBuffer(unsigned char* buffer, int maxlen, LBuffer::const_iterator citer, int clen)
+const int kCacheLineSize = 64;
+const int kCKv1PayloadLen = 512;    // KiNET v1 packets are always padded to this
+
+void CKpacket::Initialize(const CKdevice& dev, bool syncWait)
 {
-    int bytesNeeded = clen * 3;
-    if (bytesNeeded > maxlen) return -bytesNeeded;
+    int dataLen = dev.GetCount() * 3;
+    if (dev.GetKiNetVersion() == 2) {
+        iHdrLen = KiNETportOut::GetSize();
+        iMaxPayload = dataLen;
+        iLen = iHdrLen + dataLen;
+    } else {
+        iHdrLen = KiNETdmxOut::GetSize();
+        iMaxPayload = max(dataLen, kCKv1PayloadLen);
+        iLen = iHdrLen + kCKv1PayloadLen;
+    }
 
-    for (int i = 0; i < clen; ++i)
-    {
-        if (i != 0) ++citer;
-        *buffer++ = citer->rAsChar();
-        *buffer++ = citer->gAsChar();
-        *buffer++ = citer->bAsChar();
+    // Everything after the header starts (and stays) zero so the v1 padding never needs to be rewritten
+    iStorage.assign(iHdrLen + iMaxPayload + kCacheLineSize, 0);
+    size_t offset = (kCacheLineSize - ((size_t) &iStorage[0] % kCacheLineSize)) % kCacheLineSize;
+    iData = &iStorage[offset];
+
+    // Only GetSize() bytes are copied since the structs may have trailing C++ padding
+    if (dev.GetKiNetVersion() == 2) {
+        KiNETportOut header;
+        header.port = dev.GetPort();
+        header.universe = dev.GetUniverse();
+        header.len = dataLen;
+        header.flags = syncWait ? KiNETportOut::kFlagSyncWait : 0;
+        memcpy(iData, &header, iHdrLen);
+    } else {
+        KiNETdmxOut header;
+        header.universe = dev.GetUniverse();
+        memcpy(iData, &header, iHdrLen);
+    }
+}
+
+void CKpacket::Encode(const RGBColor* colors, int count)
+{
+    QuantizeRGB(colors, min(count, iMaxPayload / 3), iData + iHdrLen);
+}
+
+bool CKpacket::SamePayload(const CKpacket& packet) const
+{
+    return iLen == packet.iLen && memcmp(iData + iHdrLen, packet.iData + iHdrLen, iLen - iHdrLen) == 0;
+}
+
+//---------------------------------------------------------------------
+// Options
+//---------------------------------------------------------------------
+// Unchanged frames are only resent this often (in milliseconds) so the fixtures don't time out.
+// Zero means always send.
+Milli_t gKeepAliveInterval = 1000;
+
+string KeepAliveDefaultCallback(csref name) {
+    return IntToStr(gKeepAliveInterval);
+    }
+
+string KeepAliveCallback(csref name, csref val) {
+    int interval;
+    if (! StrToInt(val, &interval))
+        return "The --" + name + " parameter, " + val + ", was not an integer.";
+    if (interval < 0)
+        return "--" + name + " cannot be less than zero.";
+    gKeepAliveInterval = interval;
+    return "";
+}
+
+DefOption(keepalive, KeepAliveCallback, "milliseconds", "sets how often an unchanged frame is resent to ColorKinetics devices. 0 sends every frame.", KeepAliveDefaultCallback);
+
+// ckauto saves the discovered devices in this file and trusts them for gCKcacheTTL seconds
+string DefaultCKcacheFile() {
+    string home = GetEnvStr("HOME");
+    if (home.empty()) home = GetEnvStr("USERPROFILE");
+    return home.empty() ? "" : home + "/.liteckcache";
+}
+
+string  gCKcacheFile = DefaultCKcacheFile();
+int     gCKcacheTTL = 3600;
+
+string CKcacheDefaultCallback(csref name) {
+    return gCKcacheFile.empty() ? "none" : gCKcacheFile;
+    }
+
+string CKcacheCallback(csref name, csref val) {
+    gCKcacheFile = StrEQ(val, "none") ? "" : val;
+    return "";
+}
+
+DefOption(ckcache, CKcacheCallback, "filename", "sets the file where ckauto caches the ColorKinetics devices it discovers. 'none' disables the cache.", CKcacheDefaultCallback);
+
+string CKcacheTTLDefaultCallback(csref name) {
+    return IntToStr(gCKcacheTTL);
+    }
+
+string CKcacheTTLCallback(csref name, csref val) {
+    int ttl;
+    if (! StrToInt(val, &ttl))
+        return "The --" + name + " parameter, " + val + ", was not an integer.";
+    if (ttl < 0)
+        return "--" + name + " cannot be less than zero.";
+    gCKcacheTTL = ttl;
+    return "";
+}
+
+DefOption(ckcachettl, CKcacheTTLCallback, "seconds", "sets how long ckauto uses cached devices without waiting for discovery. Discovery still runs in the background.", CKcacheTTLDefaultCallback);
+
+//---------------------------------------------------------------------
+// Batching
+//---------------------------------------------------------------------
+// With --batch, each CKbuffer leaves its packet in iLastPacket during the frame and they're all sent at the end
+// of the frame from one unconnected socket (using sendmmsg on Linux).
+bool                gBatchSend = false;
+vector<CKbuffer*>   gBatch;
+Mutex               gBatchMutex;    // Devices may be updated from several threads (--outputthreads)
+SocketUDPClient     gBatchSocket;
+
+string BatchCallback(csref name, csref val) {
+    gBatchSend = true;
+    OutputThread::AddFrameEndHook(CKbuffer::SendBatch);
+    return "";
+    }
+DefOptionBool(batch, BatchCallback, "sends the packets for all ColorKinetics devices together at the end of each frame");
+
+void CKbuffer::SendBatch()
+{
+    static vector<SocketIP::Datagram> datagrams;
+    if (gBatch.empty()) return;
+    datagrams.resize(gBatch.size());
+    for (size_t i = 0; i < gBatch.size(); ++i) {
+        const CKpacket& packet = gBatch[i]->iPackets[gBatch[i]->iSentPacket];
+        datagrams[i] = SocketIP::Datagram(packet.GetData(), packet.GetLength(), &gBatch[i]->iSockAddr);
+    }
+
+    if (! gBatchSocket.IsOpen())
+        gBatchSocket.SetSockAddr(gBatch[0]->iSockAddr);
+    int numSent = gBatchSocket.SendDatagrams(&datagrams[0], datagrams.size());
+    if (numSent != (int) datagrams.size()) {
+        cerr << "Batched update failed for " << datagrams.size() - numSent << " of " << datagrams.size() << " devices: " << gBatchSocket.GetLastError() << endl;
+        for (size_t i = 0; i < datagrams.size(); ++i)
+            if (! datagrams[i].sent) gBatch[i]->iSentPacket = -1; // Resend next time
     }
-    return bytesNeeded;
+    gBatch.clear();
+}
+
+//---------------------------------------------------------------------
+// Frame sync
+//---------------------------------------------------------------------
+volatile bool       gSyncPending = false;   // Set when a sync mode device sent a packet this frame
+SocketUDPClient     gSyncSocket;
+
+void CKbuffer::SendSync()
+{
+    SendBatch();
+    if (! gSyncPending) return;
+    gSyncPending = false;
+
+    if (! gSyncSocket.IsOpen()) {
+        gSyncSocket.SetSockAddr(SockAddr(CKgetBroadcastAddress(), KiNETudpPort));
+        gSyncSocket.setsockopt_bool(SOL_SOCKET, SO_BROADCAST, true);
+    }
+    KiNETportOutSync sync;
+    if (! gSyncSocket.Write((char*) &sync, sync.GetSize()))
+        cerr << "Broadcasting PortOutSync failed: " << gSyncSocket.GetLastError() << endl;
 }
 
 //---------------------------------------------------------------------
 // CKduffer
 //---------------------------------------------------------------------
 
-CKbuffer::CKbuffer(const CKdevice& dev) : LBufferPhys(), iDevice(dev)
+CKbuffer::CKbuffer(const CKdevice& dev, bool syncWait)
+    : LBufferPhys(), iDevice(dev), iSentPacket(-1), iSyncWait(syncWait && dev.GetKiNetVersion() == 2), iLastSendTime(0), iSockAddr(dev.GetIP(), KiNETudpPort)
 {
     if (dev.GetCount() == 0) {
         iLastError = "Zero length ColorKinetics device";
     }
 
     Alloc(dev.GetCount());
+    iPackets[0].Initialize(dev, iSyncWait);
+    iPackets[1].Initialize(dev, iSyncWait);
 }
 
 
@@ -58,84 +216,60 @@ string CKbuffer::GetLastError() const
 
 string CKbuffer::GetDescriptor() const
 {
-    return iDevice.GetDescriptor();
+    string desc = iDevice.GetDescriptor();
+    if (iSyncWait)
+        desc = "ck(" + desc.substr(desc.find(':') + 1) + ",sync)";
+    return desc;
 }
 
 bool CKbuffer::PortSync()
 {
-    const int maxLen = 2048;
-    unsigned char outbuf[maxLen];
-
-    // Initialize header
-    KiNETportOutSync* header = (KiNETportOutSync*) outbuf;
-    *header = KiNETportOutSync();
-    int len = KiNETportOutSync::GetSize();
-    if (! iDevice.Write(outbuf, len))
+    KiNETportOutSync sync;
+    if (! iDevice.Write((unsigned char*) &sync, sync.GetSize()))
         cerr << "PortSync failed writing to " << iDevice.GetIP().GetString() << ": " << iDevice.GetLastError() << endl;
 
     return !HasError();
 }
 
-void UpdateOneCKv1(CKdevice& device, LBuffer::const_iterator bufIter)
+bool CKbuffer::Transmit(const RGBColor* colors, int count)
     {
-    const int maxLen = 2048;
-    unsigned char outbuf[maxLen];
-
-    KiNETdmxOut* header = (KiNETdmxOut*) outbuf;
-    int hdrLen = KiNETdmxOut::GetSize();
-    unsigned char* dataPtr = outbuf + hdrLen;
-
-    int len = device.GetCount();
-    int dataLen = CopyColorsToBuffer(dataPtr, maxLen-hdrLen, bufIter, len);
-    int paddedLen = 512;
-    // Fill in rest with zeros
-    for (int i = dataLen; i < paddedLen; ++i)
-        *(dataPtr+i) = 0;
-
-    *header = KiNETdmxOut(); // Initialize header
-    header->universe = device.GetUniverse();
-    if (! device.Write(outbuf, hdrLen+paddedLen))
+    int next = (iSentPacket == 0) ? 1 : 0;
+    CKpacket& packet = iPackets[next];
+    packet.Encode(colors, count);
+
+    // Skip the send if the fixture already has this frame and was refreshed recently
+    Milli_t now = Milliseconds();
+    bool unchanged = iSentPacket >= 0 && packet.SamePayload(iPackets[iSentPacket]);
+    if (unchanged && gKeepAliveInterval > 0 && MilliDiff(now, iLastSendTime) < gKeepAliveInterval)
+        return !HasError();
+
+    if (gBatchSend && OutputThread::IsTransmitting())
       {
-       cerr << "Update failed on " << device.GetIP().GetString() << ": " << device.GetLastError() << endl;
+       // The packet isn't touched again until the next frame, after SendBatch
+       iSentPacket = next;
+       iLastSendTime = now;
+       MutexLock lock(gBatchMutex);
+       gBatch.push_back(this);
       }
-    }
-
-void UpdateOneCKv2(CKdevice& device, LBuffer::const_iterator bufIter)
-    {
-    const int maxLen = 2048;
-    unsigned char outbuf[maxLen];
-
-    KiNETportOut* header = (KiNETportOut*) outbuf;
-    int hdrLen = KiNETportOut::GetSize();
-    unsigned char* dataPtr = outbuf + hdrLen;
-
-    int len = device.GetCount();
-    int dataLen = CopyColorsToBuffer(dataPtr, maxLen-hdrLen, bufIter, len);
-    *header = KiNETportOut(); // Initialize header
-    header->port = device.GetPort();
-    header->universe = device.GetUniverse();
-    //cout << "Port is " << device.GetPort() << endl;
-    header->len = dataLen;
-    if (! device.Write(outbuf, hdrLen+dataLen))
+    else if (iDevice.Write(packet.GetData(), packet.GetLength()))
       {
-       cerr << "Update failed on " << device.GetIP().GetString() << ": " << device.GetLastError() << endl;
+       iSentPacket = next;
+       iLastSendTime = now;
+      }
+    else
+      {
+       cerr << "Update failed on " << iDevice.GetIP().GetString() << ": " << iDevice.GetLastError() << endl;
+       iSentPacket = -1; // Resend next time
+       return !HasError();
       }
-    }
 
-bool CKbuffer::Update()
-    {
-    const_iterator bufIter = const_cast<const CKbuffer*>(this)->begin();
-    switch (iDevice.GetKiNetVersion())
-        {
-        case 2:
-            UpdateOneCKv2(iDevice, bufIter);
-            break;
-        default:
-            UpdateOneCKv1(iDevice, bufIter);
-            break;
-        }
-    // Not using sync. To enable, I think there is a flag that must be set with the PortOut command.
-    // PortSync();
+    // Outside of a frame transmission there's no frame end to wait for, so latch this device now
+    if (iSyncWait) {
+        if (OutputThread::IsTransmitting())
+            gSyncPending = true;
+        else
+            PortSync();
+    }
     return !HasError();
     }
 
@@ -143,9 +277,25 @@ bool CKbuffer::Update()
 // CKbuffer: Creating
 //---------------------------------------------------------------------
 
+// Parses the optional mode parameter of ck and ckauto. Currently the only mode is sync.
+bool ParseCKmode(const vector<string>& params, int idx, bool* syncWait, string* errmsg)
+{
+    *syncWait = false;
+    if (idx >= (int) params.size()) return true;
+    if (! StrEQ(params[idx], "sync")) {
+        if (errmsg) *errmsg = "Unknown ColorKinetics mode: " + params[idx] + ". Expected sync.";
+        return false;
+    }
+    *syncWait = true;
+    OutputThread::AddFrameEndHook(CKbuffer::SendSync);
+    return true;
+}
+
 LBuffer* CKbufferCreate(const vector<string>& params, string* errmsg)
 {
-    if (! ParamListCheck(params, "CK display buffer", errmsg, 1, 1)) return NULL;
+    if (! ParamListCheck(params, "CK display buffer", errmsg, 1, 2)) return NULL;
+    bool syncWait;
+    if (! ParseCKmode(params, 1, &syncWait, errmsg)) return NULL;
     CKdevice dev(params[0]);
     if (dev.HasError()) {
         if (errmsg) *errmsg = "Invalid device string: '" + params[0] + "': " + dev.GetLastError();
@@ -157,26 +307,110 @@ LBuffer* CKbufferCreate(const vector<string>& params, string* errmsg)
         if (errmsg) *errmsg = "Couldn't create CKbuffer: zero lights";
         return NULL;
     }
+    if (syncWait && dev.GetKiNetVersion() != 2) {
+        if (errmsg) *errmsg = "sync requires a KiNet V2 device (one with a port): " + params[0];
+        return NULL;
+    }
 
     // Prime the UDP connection
     dev.InitializeUDPConnection();
 
-    return new CKbuffer(dev);
+    return new CKbuffer(dev, syncWait);
+}
+
+// Rediscovers the devices after ckauto started with the cached ones and updates the cache for next time.
+// The current display keeps using the cached devices.
+class CKrevalidateThread : public Thread
+{
+public:
+    CKrevalidateThread(const vector<CKdevice>& cached, csref cacheFile) : iCached(cached), iCacheFile(cacheFile), iIsDone(false), iIsCancelled(false) {}
+    bool IsDone() const {return iIsDone;}
+    void Cancel()       {iIsCancelled = true;}
+protected:
+    virtual void Run() {
+        vector<CKdevice> devices = CKdiscoverDevices();
+        // Leave the cache alone if the network is down or the program is exiting
+        if (! devices.empty() && ! iIsCancelled) {
+            if (! CKsameDevices(devices, iCached))
+                cerr << "ColorKinetics devices have changed. They will be used the next time ckauto starts." << endl;
+            string errmsg;
+            if (! CKwriteDeviceCache(iCacheFile, devices, &errmsg))
+                cerr << "Couldn't update the ColorKinetics device cache: " << errmsg << endl;
+        }
+        iIsDone = true;
+    }
+private:
+    vector<CKdevice> iCached;
+    string          iCacheFile;
+    volatile bool   iIsDone;
+    volatile bool   iIsCancelled;
+};
+
+CKrevalidateThread* gRevalidateThread = NULL;
+const Milli_t       kRevalidateExitWait = 100;  // How long exit waits for revalidation to finish
+
+// Called at exit. Waits briefly for the revalidation to finish. If it doesn't, it's cancelled and abandoned
+// since discovery can't be interrupted. Abandoned threads don't touch the cache or any globals but the discovery address.
+void CKstopRevalidation() {
+    if (! gRevalidateThread) return;
+    Milli_t deadline = Milliseconds() + kRevalidateExitWait;
+    while (! gRevalidateThread->IsDone() && MilliLT(Milliseconds(), deadline))
+        SleepMilli(5);
+    if (! gRevalidateThread->IsDone()) {
+        gRevalidateThread->Cancel();
+        return;
+    }
+    gRevalidateThread->Join();
+    delete gRevalidateThread;
+    gRevalidateThread = NULL;
+}
+
+// Returns the cached devices if they're recent enough, otherwise runs discovery and caches the result
+vector<CKdevice> CKdiscoverDevicesCached(string* errmsg) {
+    vector<CKdevice> devices;
+    time_t savedTime = 0;
+    if (! gCKcacheFile.empty() && CKreadDeviceCache(gCKcacheFile, &devices, &savedTime) && ! devices.empty()) {
+        time_t age = time(NULL) - savedTime;
+        if (age >= 0 && age < gCKcacheTTL) {
+            // Discovery normally fills the ARP tables, so do it here instead
+            CKdevice::InitializeUDPConnections(devices);
+            if (! gRevalidateThread) {
+                gRevalidateThread = new CKrevalidateThread(devices, gCKcacheFile);
+                if (gRevalidateThread->Start())
+                    atexit(CKstopRevalidation);
+                else {
+                    delete gRevalidateThread;
+                    gRevalidateThread = NULL;
+                }
+            }
+            return devices;
+        }
+    }
+
+    devices = CKdiscoverDevices(errmsg);
+    if (! devices.empty() && ! gCKcacheFile.empty()) {
+        string cacheError;
+        if (! CKwriteDeviceCache(gCKcacheFile, devices, &cacheError))
+            cerr << "Couldn't save the ColorKinetics device cache: " << cacheError << endl;
+    }
+    return devices;
 }
 
 LBuffer* CKbufferAutoCreate(const vector<string>& params, string* errmsg) {
-    if (! ParamListCheck(params, "ckauto display buffer", errmsg, 0, 0)) return NULL;
+    if (! ParamListCheck(params, "ckauto display buffer", errmsg, 0, 1)) return NULL;
+    bool syncWait;
+    if (! ParseCKmode(params, 0, &syncWait, errmsg)) return NULL;
 
-    vector<CKdevice> devices = CKdiscoverDevices(errmsg);
+    vector<CKdevice> devices = CKdiscoverDevicesCached(errmsg);
     if (devices.empty()) {
         if (errmsg) *errmsg = "Didn't detect any ColorKinetics devices: " + *errmsg;
         return NULL;
     }
 
-    // Create the different CKbuffers
+    // Create the different CKbuffers. KiNet V1 devices don't support sync so they update immediately.
     vector<LBuffer*> ckbuffers;
     for (size_t i = 0; i < devices.size(); ++i)
-        ckbuffers.push_back(new CKbuffer(devices[i]));
+        ckbuffers.push_back(new CKbuffer(devices[i], syncWait));
 
     // Check for errors
     bool hasError = false;
@@ -202,11 +436,12 @@ LBuffer* CKbufferAutoCreate(const vector<string>& params, string* errmsg) {
 }
 
 // Define the creation functions
-DEFINE_LBUFFER_DEVICE_TYPE(ck, CKbufferCreate, "CK:ipaddr/port(size)[,...]",
+DEFINE_LBUFFER_DEVICE_TYPE(ck, CKbufferCreate, "CK:ipaddr/port(size) or CK(ipaddr/port(size),sync)",
         "ColorKinetics device. If port is missing, assumes a KiNet V1 device.\n"
-        "  Examples: ck:172.16.11.23/1  or  ck:10.5.4.3/1(72) or ck:172.16.11.54(21)");
+        "  With sync, the supplies all show each frame at the same time (KiNet V2 only).\n"
+        "  Examples: ck:172.16.11.23/1  or  ck:10.5.4.3/1(72) or ck:172.16.11.54(21) or ck(10.5.4.3/1(72),sync)");
 
-DEFINE_LBUFFER_DEVICE_TYPE(ckauto, CKbufferAutoCreate, "CKAUTO", "Creates a display using all of the local CK devices");
+DEFINE_LBUFFER_DEVICE_TYPE(ckauto, CKbufferAutoCreate, "CKAUTO or CKAUTO:sync", "Creates a display using all of the local CK devices");
 
 // Dummy function to force linking of this file
 void ForceLinkCK() {}
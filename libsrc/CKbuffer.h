@@ -6,27 +6,67 @@
 #include "utils.h"
 #include "LBuffer.h"
 #include "CKdevice.h"
+#include "utilsTime.h"
+
+// A persistent KiNET packet for one device. The header is written once by Initialize so each frame only
+// quantizes the colors straight into the payload. The packet starts on a cache line.
+class CKpacket
+{
+public:
+    CKpacket() : iData(NULL), iLen(0), iHdrLen(0), iMaxPayload(0) {}
+    void        Initialize(const CKdevice& dev, bool syncWait = false);  // syncWait sets kFlagSyncWait (KiNET v2 only)
+    void        Encode(const RGBColor* colors, int count);  // Extra colors are ignored
+    bool        SamePayload(const CKpacket& packet) const;
+
+    const unsigned char* GetData()  const {return iData;}
+    int         GetLength()         const {return iLen;}
+
+private:
+    vector<unsigned char> iStorage;
+    unsigned char*  iData;          // Start of the packet within iStorage
+    int             iLen;           // Length sent
+    int             iHdrLen;
+    int             iMaxPayload;    // Room for colors after the header
+    // Don't allow copying since iData points into iStorage
+    CKpacket(const CKpacket&);
+    CKpacket& operator=(const CKpacket&);
+};
 
 class CKbuffer : public LBufferPhys
 {
 public:
     //CKbuffer() : LBufferPhys() {}
-    CKbuffer(const CKdevice& dev);
+    CKbuffer(const CKdevice& dev, bool syncWait = false);
     virtual ~CKbuffer() {}
     //bool    AddDevice(const CKdevice& dev);
 
     virtual bool    HasError()       const;
     virtual string  GetLastError()   const;
     virtual string  GetDescriptor()  const;
-    virtual bool    Update();
     virtual bool    PortSync();
 
+    // With --batch, packets for a frame are held and then sent together by this (see OutputThread::AddFrameEndHook)
+    static void     SendBatch();
+    // In sync mode, the supplies hold each PortOut until this broadcasts a PortOutSync at the end of the frame,
+    // so every supply shows the frame at the same moment. Also sends the batch first.
+    static void     SendSync();
+
     // Alternative creation methods
 //    static bool    CreateFromArglist(CKbuffer* buffer, int* argc, char** argv);
 //    static bool    CreateFromXML(CKbuffer* buffer, const CKxmldoc& xmldoc);
 
+protected:
+    virtual bool    Transmit(const RGBColor* colors, int count);
+
 private:
     CKdevice iDevice;
+    // Each frame is encoded into one packet while the other holds the last one sent, which is used to skip
+    // sending unchanged frames. iSentPacket is -1 if nothing valid has been sent.
+    CKpacket iPackets[2];
+    int     iSentPacket;
+    bool    iSyncWait;
+    Milli_t iLastSendTime;
+    SockAddr iSockAddr;
     // Don't allow copying
     CKbuffer(const CKbuffer&);
     CKbuffer& operator=(const CKbuffer&);
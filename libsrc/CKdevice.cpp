@@ -5,6 +5,10 @@
 #include "utilsTime.h"
 #include <iostream>
 #include <stdio.h>
+#include <map>
+#include <sstream>
+#include "utilsFile.h"
+#include "utilsOptions.h"
 
 //---------------------------------------------------------------------
 // KiNET utilities
@@ -233,13 +237,28 @@ set<IPAddr> gInitializedIPs;
 const int gUDPInitDelay = 10;  // Smount of time to wait for the UDP connection to be initialized
 void CKdevice::InitializeUDPConnection()
 {
-  if (gInitializedIPs.find(iIP) != gInitializedIPs.end()) return;
-  // Sends a single Poll packet and sleeps.  Uses a separate socket to not interfere with other sockets?
-  SocketUDPClient socket(iIP, KiNETudpPort);
+  InitializeUDPConnections(vector<CKdevice>(1, *this));
+}
+
+void CKdevice::InitializeUDPConnections(const vector<CKdevice>& devices)
+{
+  // Sends a single Poll packet to each new IP and then sleeps once.
+  vector<SockAddr> addrs;
+  for (size_t i = 0; i < devices.size(); ++i) {
+    IPAddr ip = devices[i].GetIP();
+    if (gInitializedIPs.find(ip) != gInitializedIPs.end()) continue;
+    gInitializedIPs.insert(ip);
+    addrs.push_back(SockAddr(ip, KiNETudpPort));
+  }
+  if (addrs.empty()) return;
+
   KiNETdiscover pollPacket;
-  Write((unsigned char*) &pollPacket, pollPacket.GetSize());
+  vector<SocketIP::Datagram> datagrams;
+  for (size_t i = 0; i < addrs.size(); ++i)
+    datagrams.push_back(SocketIP::Datagram(&pollPacket, pollPacket.GetSize(), &addrs[i]));
+  SocketUDPClient socket(addrs[0]);
+  socket.SendDatagrams(&datagrams[0], datagrams.size());
   SleepMilli(gUDPInitDelay);
-  gInitializedIPs.insert(iIP);
 }
   
 //---------------------------------------------------------------------
@@ -291,11 +310,32 @@ bool CKdevice::Ping(int timeout, int numPings)
 // Polling the CK devices on the network
 //---------------------------------------------------------------------
 
+// --ckbroadcast can point discovery at one supply or at an emulator on a network without broadcast (see ckemu)
+IPAddr gCKbroadcastAddress((uint32) INADDR_BROADCAST);
+
+IPAddr CKgetBroadcastAddress() {
+    return gCKbroadcastAddress;
+}
+
+string CKbroadcastDefaultCallback(csref name) {
+    return gCKbroadcastAddress.GetString();
+    }
+
+string CKbroadcastCallback(csref name, csref val) {
+    IPAddr addr(val);
+    if (! addr.IsValid())
+        return "The --" + name + " parameter, " + val + ", was not an IP address.";
+    gCKbroadcastAddress = addr;
+    return "";
+}
+
+DefOption(ckbroadcast, CKbroadcastCallback, "ipaddr", "sets the address used to discover and sync all of the ColorKinetics supplies.", CKbroadcastDefaultCallback);
+
 vector<CKinfo> CKdiscoverInfo(string* errmsg, int timeoutInMS) {
     vector<CKinfo> retval;
 
     // Create the client socket for the polling request
-    SockAddr sa(INADDR_BROADCAST, KiNETudpPort); //use broadcast address
+    SockAddr sa(gCKbroadcastAddress, KiNETudpPort); //use broadcast address
     SocketUDPClient sock(sa);
     sock.setsockopt_bool(SOL_SOCKET, SO_BROADCAST, true);
 
@@ -332,101 +372,59 @@ vector<CKinfo> CKdiscoverInfo(string* errmsg, int timeoutInMS) {
 }
 
 const int kDefaultCountTimeout = 2500; // timeout in MS
-bool GetDevicesForInfoV1(const CKinfo& info, vector<CKdevice>* devices, string* errmsg = NULL) {
-    const int buflen = 1000;
-    char buffer[buflen];
-    int bytesRead = 0;
-    IPAddr ipaddr(info.ipaddr);
-    int universe = info.universe;
-    // Write the GetCount request
-    SocketUDPClient sock(ipaddr, KiNETudpPort);
-    KiNETblinkScan1 getCountPacket;
-    sock.Write((char*) &getCountPacket, getCountPacket.GetSize());
-    if (sock.HasError()) {
-        if (errmsg) *errmsg = "Error writing CK getCount1 packet: " + sock.GetLastError();
-        sock.Close();
-        return false;
-    }
-
-    // Parse the results
-    if (sock.HasData(kDefaultCountTimeout) && sock.Read(buffer, buflen, &bytesRead)) {
-        if (bytesRead >= KiNETblinkScan1CAReply::GetSize()) {
-            KiNETblinkScan1CAReply* replyPtr = (KiNETblinkScan1CAReply*) buffer;
-            int count = 0;
-            for (int i = 0; i < 4; ++i)
-                count += replyPtr->counts[i];
-            CKdevice dev(ipaddr, universe, 0, count); // v1 devices don't really use the port concept
-            dev.SetKiNetVersion(1); // This is a v1 feature
-            devices->push_back(dev);
-            sock.Close();
-            return true;
-        }
-        else {
-            if (errmsg)
-                *errmsg = "Error: CK getCount1Reply packet was too short. Got " + IntToStr(bytesRead) + " bytes, but was expecting at least " + IntToStr(KiNETblinkScan1Reply::GetSize()) + " bytes";
-            sock.Close();
-            return false;
-        }
-    }
 
-    if (sock.HasError()) {
+// A blink scan of one power supply. All of the scans are sent at once from one socket and the replies are
+// matched to the scans by their source address, so discovery takes as long as the slowest supply.
+struct CKscan {
+    CKscan(const CKinfo& infoArg) : info(infoArg), addr(IPAddr(infoArg.ipaddr), KiNETudpPort), done(false) {}
+    CKinfo              info;
+    SockAddr            addr;
+    bool                done;       // The supply has sent all of its replies
+    vector<CKdevice>    devices;
+};
+
+bool ParseBlinkScan1Reply(CKscan* scan, const char* buffer, int bytesRead, string* errmsg) {
+    if (bytesRead < KiNETblinkScan1CAReply::GetSize()) {
         if (errmsg)
-            *errmsg = "Error reading CK getCount1Reply packet: " + sock.GetLastError();
-        sock.Close();
+            *errmsg = "Error: CK getCount1Reply packet was too short. Got " + IntToStr(bytesRead) + " bytes, but was expecting at least " + IntToStr(KiNETblinkScan1Reply::GetSize()) + " bytes";
+        scan->done = true;
         return false;
-    } else {
-        sock.Close();
-        return true;
     }
+    KiNETblinkScan1CAReply* replyPtr = (KiNETblinkScan1CAReply*) buffer;
+    int count = 0;
+    for (int i = 0; i < 4; ++i)
+        count += replyPtr->counts[i];
+    CKdevice dev(scan->addr.GetIPAddr(), scan->info.universe, 0, count); // v1 devices don't really use the port concept
+    dev.SetKiNetVersion(1); // This is a v1 feature
+    scan->devices.push_back(dev);
+    scan->done = true;
+    return true;
 }
 
-bool GetDevicesForInfoV2(const CKinfo& info, vector<CKdevice>* devices, string* errmsg = NULL) {
-    const int buflen = 1000;
-    char buffer[buflen];
-    int bytesRead = 0;
-    IPAddr ipaddr(info.ipaddr);
-    // Write the GetCount request
-    SocketUDPClient sock(ipaddr, KiNETudpPort);
-    KiNETblinkScan2 getCountPacket;
-    sock.Write((char*) &getCountPacket, getCountPacket.GetSize());
-    if (sock.HasError()) {
-        if (errmsg) *errmsg = "Error writing CK blinkScan2 packet: " + sock.GetLastError();
-        sock.Close();
-        return false;
+bool ParseBlinkScan2Reply(CKscan* scan, const char* buffer, int bytesRead, string* errmsg) {
+    if (bytesRead < KiNETblinkScan2Reply::GetSize()) return true;  // Ignored like before
+    KiNETblinkScan2Reply* replyPtr = (KiNETblinkScan2Reply*) buffer;
+    if (replyPtr->replyType == KiNETblinkScan2Reply::kEnd) {
+        scan->done = true; // Done reading
+        return true;
     }
-
-    // Parse the results
-    while (sock.HasData(kDefaultCountTimeout) && sock.Read(buffer, buflen, &bytesRead)) {
-        //cout << "BytesRead=" << bytesRead << "  size " << KiNETblinkScan2Reply::GetSize() << endl;
-        if (bytesRead >= KiNETblinkScan2Reply::GetSize()) {
-            KiNETblinkScan2Reply* replyPtr = (KiNETblinkScan2Reply*) buffer;
-            if (replyPtr->replyType == KiNETblinkScan2Reply::kEnd) break; // Done reading
-            if (replyPtr->replyType == KiNETblinkScan2Reply::kData) {
-                // We have the count data
-                KiNETblinkScan2Data* countDataPtr = (KiNETblinkScan2Data*) (buffer + KiNETblinkScan2Reply::GetSize());
-                KiNETblinkScan2Data* countDataEnd = (KiNETblinkScan2Data*) (buffer + bytesRead);
-                while (countDataPtr < countDataEnd) {
-                    int universe = info.universe;
-                    int port = countDataPtr->portnum;
-                    int count = countDataPtr->count;
-                    if (port >= 1 && count > 0) {
-                        CKdevice dev(ipaddr, universe, port, count);
-                        if (info.kinetVersion == 1 || info.kinetVersion == 2)
-                            dev.SetKiNetVersion(info.kinetVersion);
-                        devices->push_back(dev);
-                    }
-                    ++countDataPtr;
-                }
+    if (replyPtr->replyType == KiNETblinkScan2Reply::kData) {
+        // We have the count data
+        KiNETblinkScan2Data* countDataPtr = (KiNETblinkScan2Data*) (buffer + KiNETblinkScan2Reply::GetSize());
+        KiNETblinkScan2Data* countDataEnd = (KiNETblinkScan2Data*) (buffer + bytesRead);
+        while (countDataPtr < countDataEnd) {
+            int universe = scan->info.universe;
+            int port = countDataPtr->portnum;
+            int count = countDataPtr->count;
+            if (port >= 1 && count > 0) {
+                CKdevice dev(scan->addr.GetIPAddr(), universe, port, count);
+                if (scan->info.kinetVersion == 1 || scan->info.kinetVersion == 2)
+                    dev.SetKiNetVersion(scan->info.kinetVersion);
+                scan->devices.push_back(dev);
             }
+            ++countDataPtr;
         }
     }
-    if (sock.HasError()) {
-        if (errmsg) *errmsg = "Error reading CK blinkScan2Reply packet: " + sock.GetLastError();
-        sock.Close();
-        return false;
-    }
-
-    sock.Close();
     return true;
 }
 
@@ -438,21 +436,146 @@ vector<CKdevice> CKdiscoverDevices(string* errmsg, int timeoutInMS) {
 
 vector<CKdevice> CKdiscoverDevices(const vector<CKinfo>& infos, string* errmsg) {
     vector<CKdevice> devices;
+    if (infos.empty()) return devices;
 
-    // For each info, poll for the count of lights
+    vector<CKscan> scans;
+    map<IPAddr, int> scanIndex;
     for (size_t i = 0; i < infos.size(); ++i) {
-        CKinfo info = infos[i];
-        switch (info.kinetVersion)
-        {
-        case 1:
-            // Old protocol
-            GetDevicesForInfoV1(info, &devices, errmsg);
-            break;
-        default:
-            // Default to newer protocol
-            GetDevicesForInfoV2(info, &devices, errmsg);
+        // A supply may answer discovery more than once. Scan it once or the extra scan would wait for the timeout.
+        IPAddr ip(infos[i].ipaddr);
+        if (scanIndex.count(ip)) continue;
+        scanIndex.insert(make_pair(ip, (int) scans.size()));
+        scans.push_back(CKscan(infos[i]));
+    }
+
+    // Send every blink scan at once. KiNet v1 supplies use the old protocol, everything else the newer one.
+    KiNETblinkScan1 scan1Packet;
+    KiNETblinkScan2 scan2Packet;
+    vector<SocketIP::Datagram> datagrams(scans.size());
+    for (size_t i = 0; i < scans.size(); ++i) {
+        if (scans[i].info.kinetVersion == 1)
+            datagrams[i] = SocketIP::Datagram(&scan1Packet, scan1Packet.GetSize(), &scans[i].addr);
+        else
+            datagrams[i] = SocketIP::Datagram(&scan2Packet, scan2Packet.GetSize(), &scans[i].addr);
+    }
+    SocketUDPClient sock(scans[0].addr);
+    int numSent = sock.SendDatagrams(&datagrams[0], datagrams.size());
+    if (numSent != (int) datagrams.size()) {
+        if (errmsg) *errmsg = "Error writing CK blink scan packet: " + sock.GetLastError();
+        for (size_t i = 0; i < scans.size(); ++i)
+            if (! datagrams[i].sent) scans[i].done = true;
+    }
+
+    // Collect the replies until every supply is done or the timeout is reached
+    const int buflen = 1000;
+    char buffer[buflen];
+    int bytesRead = 0;
+    int numRemaining = 0;
+    for (size_t i = 0; i < scans.size(); ++i)
+        if (! scans[i].done) ++numRemaining;
+    Milli_t deadline = Milliseconds() + kDefaultCountTimeout;
+
+    while (numRemaining > 0) {
+        Milli_t now = Milliseconds();
+        if (! MilliLT(now, deadline) || ! sock.HasData(MilliDiff(deadline, now))) break;
+        SockAddr srcAddr;
+        if (! sock.Read(buffer, buflen, &srcAddr, &bytesRead)) {
+            // E.g., Windows reports an ICMP port unreachable from one supply this way. Keep listening for the others.
+            cerr << "Error reading CK blink scan reply: " << sock.GetLastError() << endl;
+            continue;
         }
+
+        map<IPAddr, int>::const_iterator found = scanIndex.find(srcAddr.GetIPAddr());
+        if (found == scanIndex.end()) continue;
+        CKscan& scan = scans[found->second];
+        if (scan.done) continue;
+        if (scan.info.kinetVersion == 1)
+            ParseBlinkScan1Reply(&scan, buffer, bytesRead, errmsg);
+        else
+            ParseBlinkScan2Reply(&scan, buffer, bytesRead, errmsg);
+        if (scan.done) --numRemaining;
+    }
+    if (sock.HasError()) {
+        if (errmsg) *errmsg = "Error reading CK blink scan reply: " + sock.GetLastError();
     }
 
+    // Keep the devices in the order of the infos
+    for (size_t i = 0; i < scans.size(); ++i)
+        devices.insert(devices.end(), scans[i].devices.begin(), scans[i].devices.end());
     return devices;
 }
+
+//---------------------------------------------------------------------
+// Discovery cache
+//---------------------------------------------------------------------
+// The file is text. After a comment line, "time <seconds>" gives when it was saved and each device is a line of
+//   device <ip> <port> <count> <universe> <kinetVersion>
+
+const string kCacheHeader = "# Lite ColorKinetics discovery cache";
+
+string CKdeviceCacheLines(const vector<CKdevice>& devices) {
+    string r;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        const CKdevice& dev = devices[i];
+        r += "device " + dev.GetIP().GetString() + " " + IntToStr(dev.GetPort()) + " " + IntToStr(dev.GetCount()) + " "
+           + IntToStr(dev.GetUniverse()) + " " + IntToStr(dev.GetKiNetVersion()) + "\n";
+    }
+    return r;
+}
+
+bool CKsameDevices(const vector<CKdevice>& a, const vector<CKdevice>& b) {
+    return CKdeviceCacheLines(a) == CKdeviceCacheLines(b);
+}
+
+bool CKwriteDeviceCache(csref filename, const vector<CKdevice>& devices, string* errmsg) {
+    string contents = kCacheHeader + "\ntime " + IntToStr((int) time(NULL)) + "\n" + CKdeviceCacheLines(devices);
+    File file(filename);
+    if (! file.WriteFromString(contents)) {
+        if (errmsg) *errmsg = file.GetLastError();
+        return false;
+    }
+    return true;
+}
+
+bool CKreadDeviceCache(csref filename, vector<CKdevice>* devices, time_t* savedTime, string* errmsg) {
+    string contents;
+    File file(filename);
+    if (! file.ReadToString(&contents)) {
+        if (errmsg) *errmsg = file.GetLastError();
+        return false;
+    }
+
+    istringstream in(contents);
+    string line;
+    bool hasTime = false, isBad = false;
+    vector<CKdevice> cached;
+    while (getline(in, line)) {
+        line = TrimWhitespace(line);
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string keyword;
+        fields >> keyword;
+        if (keyword == "time") {
+            long seconds;
+            if (! (fields >> seconds)) {isBad = true; break;}
+            if (savedTime) *savedTime = seconds;
+            hasTime = true;
+        } else if (keyword == "device") {
+            string ip;
+            int port, count, universe, version;
+            if (! (fields >> ip >> port >> count >> universe >> version)) {isBad = true; break;}
+            CKdevice dev(IPAddr(ip), universe, port, count);
+            dev.SetKiNetVersion(version);
+            cached.push_back(dev);
+        } else {
+            isBad = true;
+            break;
+        }
+    }
+    if (isBad || ! hasTime) {
+        if (errmsg) *errmsg = "Badly formatted ColorKinetics cache file " + filename + (isBad ? ": " + line : "");
+        return false;
+    }
+    *devices = cached;
+    return true;
+}
@@ -10,6 +10,7 @@
 #include "utilsIP.h"
 #include "utilsSocket.h"
 #include <vector>
+#include <time.h>
 
 namespace CK
 {
@@ -57,6 +58,8 @@ public:
     // Attempts to contact the CK device. Returns true if it succeeds. See comments in source why this isn't very useful.
     bool        Ping(int timeout = 50, int numPings = 2);  
     void        InitializeUDPConnection();
+    // Same as calling InitializeUDPConnection on each device but only waits once
+    static void InitializeUDPConnections(const vector<CKdevice>& devices);
 
     // Writes a KiNET UDP packet to this device
     bool        Write(const unsigned char* buffer, int len);
@@ -97,5 +100,12 @@ struct CKinfo {
 vector<CKdevice>    CKdiscoverDevices(string* errmsg = NULL, int timeoutInMS = CK::kDefaultPollTimeout);
 vector<CKdevice>    CKdiscoverDevices(const vector<CKinfo>& infos, string* errmsg = NULL);
 vector<CKinfo>      CKdiscoverInfo   (string* errmsg = NULL, int timeoutInMS = CK::kDefaultPollTimeout);
+// Where packets for every supply (discovery and PortOutSync) are sent. The broadcast address unless --ckbroadcast is used.
+IPAddr              CKgetBroadcastAddress();
+
+// Discovery cache. Saves the discovered devices in a text file along with when they were saved.
+bool                CKreadDeviceCache (csref filename, vector<CKdevice>* devices, time_t* savedTime, string* errmsg = NULL);
+bool                CKwriteDeviceCache(csref filename, const vector<CKdevice>& devices, string* errmsg = NULL);
+bool                CKsameDevices     (const vector<CKdevice>& a, const vector<CKdevice>& b);  // Includes universe and KiNet version
 
 #endif // CKDEVICE_H_INCLUDED
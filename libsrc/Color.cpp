@@ -177,7 +177,7 @@ Color* Color::AllocFromString(csref strarg, string* errmsg, bool ignoreRangeErro
         str = CheckAndRemoveParens(str.substr(3), errmsg);
         if (str.empty()) return NULL;
         if (ParseColorComponents(str, &a, &b, &c, errmsg, ignoreRangeErrors))
-            return new RGBColor(a,b,c);
+            return new RGBColorObj(a,b,c);
         else
             return NULL;
     } else if (StrStartsWith(str, "HSV")) {
@@ -188,7 +188,7 @@ Color* Color::AllocFromString(csref strarg, string* errmsg, bool ignoreRangeErro
         else
             return NULL;
     } else if (ParseNamedColor(str, &a, &b, &c)) {
-        return new RGBColor(a,b,c);
+        return new RGBColorObj(a,b,c);
     } 
     // Doesn't make sense to support this old syntax
     //else if (ParseColorComponents(str, &a, &b, &c, errmsg, ignoreRangeErrors))
@@ -217,7 +217,7 @@ template<>
 // RGBColor
 //--------------------------------------------------------------------------
 // Constructors
-RGBColor::RGBColor(const Color& color) : Color() {
+RGBColor::RGBColor(const Color& color) {
     color.ToRGBColor(this);
 }
 
@@ -475,11 +475,6 @@ HSVColor& HSVColor::operator/=(const float& m) {
 // HSVColorRange
 //--------------------------------------------------------------------------
 
-HSVColorRange::HSVColorRange(const Color& cc1, const Color& cc2) {
-    c1 = HSVColor(cc1);
-    c2 = HSVColor(cc2);
-}
-
 HSVColor HSVColorRange::GetColor(float index) const {
     if      (index < 0) index = 0.0;
     else if (index > 1) index = 1.0;
@@ -32,12 +32,15 @@ public:
     virtual Color* AllocateCopy() const = 0;
     };
 
-class RGBColor : public Color
+// Plain pixel type used for all frame buffers and color arithmetic.
+// Deliberately not part of the Color hierarchy so it has no vtable and can be copied with memcpy.
+// Use RGBColorObj when an RGB value is needed as a Color.
+class RGBColor
   {
 public:
-    RGBColor(float rr, float gg, float bb) : Color() {r = rr; g = gg; b = bb;}
+    RGBColor(float rr, float gg, float bb) {r = rr; g = gg; b = bb;}
     RGBColor(const Color& color);
-    RGBColor() : Color() {r = g = b = 0;}
+    RGBColor() {r = g = b = 0;}
 
     // Create from a string.  Returns true if successful
     // RGB components are from 0 to 1 and separated by spaces or commas.
@@ -57,12 +60,24 @@ public:
     float g;
     float b;
     // These return the components as 8-bit chars from 0 to 255
-	virtual unsigned char rAsChar(void) const;
-	virtual unsigned char gAsChar(void) const;
-	virtual unsigned char bAsChar(void) const;
-    virtual void ToRGBColor(RGBColor* colorptr) const {*colorptr = *this;}
-    virtual string ToString() const;
-    virtual Color* AllocateCopy() const {return new RGBColor(*this);}
+	unsigned char rAsChar(void) const;
+	unsigned char gAsChar(void) const;
+	unsigned char bAsChar(void) const;
+    string ToString() const;
+  };
+
+// An RGBColor that is part of the Color hierarchy. Returned by Color::AllocFromString for RGB colors.
+class RGBColorObj : public Color
+  {
+public:
+    RGBColorObj(float rr, float gg, float bb) : Color(), rgb(rr, gg, bb) {}
+    RGBColorObj(const RGBColor& color) : Color(), rgb(color) {}
+    RGBColorObj() : Color() {}
+
+    RGBColor rgb;
+    virtual void ToRGBColor(RGBColor* colorptr) const {*colorptr = rgb;}
+    virtual string ToString() const {return rgb.ToString();}
+    virtual Color* AllocateCopy() const {return new RGBColorObj(*this);}
   };
 
 class HSVColor : public Color
@@ -71,6 +86,7 @@ class HSVColor : public Color
 public:
     HSVColor(float hh, float ss, float vv) : Color() {h = hh; s = ss; v = vv;}
     HSVColor(const Color& color);
+    HSVColor(const RGBColor& rgb) : Color() {SetFromRGB(rgb);}
     HSVColor() : Color() {h = s = v = 0;}
 
     // Create from a string.  Returns true if successful
@@ -118,7 +134,7 @@ class HSVColorRange
 {
 public:
     HSVColorRange() : c1(BLACK), c2(WHITE) {}
-    HSVColorRange(const Color& cc1, const Color& cc2);
+    HSVColorRange(const HSVColor& cc1, const HSVColor& cc2) : c1(cc1), c2(cc2) {}
     HSVColor GetRandomColor(void) const;  // returns a random color from the range
     HSVColor GetColor(float index) const; // returns a color from within the range (0 <= range <= 1)
     HSVColor c1;
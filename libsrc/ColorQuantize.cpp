@@ -0,0 +1,166 @@
+// Converts frames of RGBColors to 8-bit device values
+// The frame is treated as a flat array of floats (RGBColor is a plain struct of three floats), so the
+// SIMD versions simply quantize 16 or 32 channel values at a time and reordering is done afterwards.
+
+#include "utils.h"
+#include "ColorQuantize.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUANTIZE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANTIZE_AVX2 1 // Chosen at runtime if the CPU supports it
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QUANTIZE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The SIMD code relies on the frame being an array of floats
+typedef char RGBColorMustBeThreeFloats[sizeof(RGBColor) == 3 * sizeof(float) ? 1 : -1];
+
+namespace {
+
+// Note that NaN becomes 0 here and in the SSE2 version
+inline unsigned char QuantizeOne(float x) {
+    x = x > 0.0F ? x : 0.0F;
+    x = x < 1.0F ? x : 1.0F;
+    return (unsigned char) (int) (x * 255.0F + 0.5F);
+}
+
+void QuantizeFloats(const float* in, int len, unsigned char* out) {
+    for (int i = 0; i < len; ++i)
+        out[i] = QuantizeOne(in[i]);
+}
+
+// For each output position, the input channel it comes from
+const int kChannelSelect[6][3] = {{0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0}};
+
+void ReorderChannels(unsigned char* dest, int count, ChannelOrder_t order) {
+    if (order == kChannelOrderRGB) return;
+    const int* sel = kChannelSelect[order];
+    for (int i = 0; i < count; ++i, dest += 3) {
+        unsigned char rgb[3] = {dest[0], dest[1], dest[2]};
+        dest[0] = rgb[sel[0]];
+        dest[1] = rgb[sel[1]];
+        dest[2] = rgb[sel[2]];
+    }
+}
+
+#ifdef QUANTIZE_SSE2
+// Returns the number of values processed. The caller handles the remainder.
+int QuantizeFloatsSSE2(const float* in, int len, unsigned char* out) {
+    const __m128 zero  = _mm_setzero_ps();
+    const __m128 one   = _mm_set1_ps(1.0F);
+    const __m128 scale = _mm_set1_ps(255.0F);
+    const __m128 half  = _mm_set1_ps(0.5F);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i q[4];
+        for (int j = 0; j < 4; ++j) {
+            __m128 v = _mm_loadu_ps(in + i + j * 4);
+            v = _mm_min_ps(_mm_max_ps(v, zero), one);
+            q[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+        }
+        __m128i lo = _mm_packs_epi32(q[0], q[1]);
+        __m128i hi = _mm_packs_epi32(q[2], q[3]);
+        _mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+#endif
+
+#ifdef QUANTIZE_AVX2
+__attribute__((target("avx2")))
+int QuantizeFloatsAVX2(const float* in, int len, unsigned char* out) {
+    const __m256 zero  = _mm256_setzero_ps();
+    const __m256 one   = _mm256_set1_ps(1.0F);
+    const __m256 scale = _mm256_set1_ps(255.0F);
+    const __m256 half  = _mm256_set1_ps(0.5F);
+    // The packs work within 128-bit lanes, so the 32-bit groups come out interleaved
+    const __m256i unshuffle = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i q[4];
+        for (int j = 0; j < 4; ++j) {
+            __m256 v = _mm256_loadu_ps(in + i + j * 8);
+            v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+            q[j] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half));
+        }
+        __m256i lo = _mm256_packs_epi32(q[0], q[1]);
+        __m256i hi = _mm256_packs_epi32(q[2], q[3]);
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), unshuffle);
+        _mm256_storeu_si256((__m256i*) (out + i), packed);
+    }
+    return i;
+}
+
+bool HasAVX2() {
+    static bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+#endif
+
+#ifdef QUANTIZE_NEON
+int QuantizeFloatsNEON(const float* in, int len, unsigned char* out) {
+    const float32x4_t zero  = vdupq_n_f32(0.0F);
+    const float32x4_t one   = vdupq_n_f32(1.0F);
+    const float32x4_t half  = vdupq_n_f32(0.5F);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint16x4_t q[4];
+        for (int j = 0; j < 4; ++j) {
+            float32x4_t v = vld1q_f32(in + i + j * 4);
+            v = vminq_f32(vmaxq_f32(v, zero), one);
+            v = vaddq_f32(vmulq_n_f32(v, 255.0F), half);
+            q[j] = vmovn_u32(vcvtq_u32_f32(v));
+        }
+        uint8x8_t lo = vmovn_u16(vcombine_u16(q[0], q[1]));
+        uint8x8_t hi = vmovn_u16(vcombine_u16(q[2], q[3]));
+        vst1q_u8(out + i, vcombine_u8(lo, hi));
+    }
+    return i;
+}
+#endif
+
+}; // namespace
+
+void QuantizeRGBScalar(const RGBColor* src, int count, unsigned char* dest, ChannelOrder_t order) {
+    if (count <= 0) return;
+    QuantizeFloats(&src->r, count * 3, dest);
+    ReorderChannels(dest, count, order);
+}
+
+void QuantizeRGB(const RGBColor* src, int count, unsigned char* dest, ChannelOrder_t order) {
+    if (count <= 0) return;
+    const float* in = &src->r;
+    int len  = count * 3;
+    int done = 0;
+#if defined(QUANTIZE_AVX2)
+    if (HasAVX2())
+        done = QuantizeFloatsAVX2(in, len, dest);
+#endif
+#if defined(QUANTIZE_SSE2)
+    done += QuantizeFloatsSSE2(in + done, len - done, dest + done);
+#elif defined(QUANTIZE_NEON)
+    done += QuantizeFloatsNEON(in + done, len - done, dest + done);
+#endif
+    QuantizeFloats(in + done, len - done, dest + done);
+    ReorderChannels(dest, count, order);
+}
+
+string QuantizeRGBImplementation() {
+#if defined(QUANTIZE_AVX2)
+    if (HasAVX2()) return "AVX2";
+#endif
+#if defined(QUANTIZE_SSE2)
+    return "SSE2";
+#elif defined(QUANTIZE_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
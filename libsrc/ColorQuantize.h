@@ -0,0 +1,24 @@
+// Converts frames of RGBColors to 8-bit device values
+//
+
+#ifndef COLORQUANTIZE_H_INCLUDED
+#define COLORQUANTIZE_H_INCLUDED
+
+#include "Config.h"
+#include "Color.h"
+
+// Order in which the channels are written for each pixel
+typedef enum {kChannelOrderRGB = 0, kChannelOrderRBG = 1, kChannelOrderGRB = 2,
+              kChannelOrderGBR = 3, kChannelOrderBRG = 4, kChannelOrderBGR = 5} ChannelOrder_t;
+
+// Writes 3 * count bytes to dest. Each channel is clamped to 0..1, scaled to 0..255 and rounded.
+// Uses SSE2/AVX2 or NEON when available.
+void QuantizeRGB(const RGBColor* src, int count, unsigned char* dest, ChannelOrder_t order = kChannelOrderRGB);
+
+// Same results as QuantizeRGB but never uses SIMD. Mainly for testing.
+void QuantizeRGBScalar(const RGBColor* src, int count, unsigned char* dest, ChannelOrder_t order = kChannelOrderRGB);
+
+// Returns the name of the implementation used by QuantizeRGB (e.g., "SSE2")
+string QuantizeRGBImplementation();
+
+#endif // !COLORQUANTIZE_H_INCLUDED
@@ -2,6 +2,8 @@
 #include "utils.h"
 #include "ComboBuffer.h"
 #include "utilsParse.h"
+#include "OutputThread.h"
+#include <algorithm>
 
 //-----------------------------------------------------------------------------
 // ComboBuffer
@@ -18,21 +20,88 @@ string ComboBuffer::GetDescriptor() const {
     return s;
 }
 
+struct ParallelUpdateInfo_t {
+    const vector<LBuffer*>* buffers;
+    vector<char>            results;
+};
+
+void ParallelUpdateOne(int idx, void* infoArg) {
+    ParallelUpdateInfo_t* info = (ParallelUpdateInfo_t*) infoArg;
+    info->results[idx] = (*info->buffers)[idx]->Update();
+}
+
 bool ComboBuffer::Update() {
+    // Sort out the buffers that can be updated from other threads. While the output thread is running,
+    // buffers here only copy their frame so there's nothing to gain.
+    vector<LBuffer*> parallel;
+    if (OutputThread::GetNumThreads() > 1 && ! OutputThread::IsFrameOpen()) {
+        for (vector<LBuffer*>::const_iterator i = iBuffers.begin(); i != iBuffers.end(); ++i)
+            if ((*i)->CanUpdateAsync()) parallel.push_back(*i);
+    }
+
     bool success = true;
+    if (parallel.size() > 1) {
+        ParallelUpdateInfo_t info;
+        info.buffers = &parallel;
+        info.results.resize(parallel.size());
+        OutputThread::ParallelFor(parallel.size(), ParallelUpdateOne, &info);
+        for (size_t i = 0; i < info.results.size(); ++i)
+            success = info.results[i] && success;
+    } else
+        parallel.clear();
+
     for (vector<LBuffer*>::const_iterator i = iBuffers.begin(); i != iBuffers.end(); ++i)
-        success = (*i)->Update() && success;
+        if (parallel.empty() || ! (*i)->CanUpdateAsync())
+            success = (*i)->Update() && success;
     return success;
 }
 
+bool ComboBuffer::CanUpdateAsync() const {
+    for (vector<LBuffer*>::const_iterator i = iBuffers.begin(); i != iBuffers.end(); ++i)
+        if (! (*i)->CanUpdateAsync()) return false;
+    return true;
+}
+
 RGBColor& ComboBuffer::GetRawRGB(int idx) {
-    for (size_t i = 0; i < iBuffers.size(); ++i) {
-        if (idx < iCounts[i])
-            return iBuffers[i]->GetRawRGB(idx);
-        else
-            idx = idx - iCounts[i];
+    const Segment_t& seg = iSegments[iPixelSegments[idx]];
+    return seg.buffer->GetRawRGB(idx - seg.start);
+}
+
+RGBColor* ComboBuffer::GetRawSpan(int idx, int count) {
+    const Segment_t& seg = iSegments[iPixelSegments[idx]];
+    if (idx + count > seg.start + seg.count) return NULL;
+    return seg.buffer->GetRawSpan(idx - seg.start, count);
+}
+
+// The bulk functions hand each segment's buffer the contiguous part of the range that belongs to it
+void ComboBuffer::ReadRaw(int idx, int count, RGBColor* dest) {
+    int segnum = iPixelSegments[idx];
+    while (count > 0) {
+        const Segment_t& seg = iSegments[segnum++];
+        int num = min(count, seg.start + seg.count - idx);
+        seg.buffer->ReadRaw(idx - seg.start, num, dest);
+        idx += num; dest += num; count -= num;
+    }
+}
+
+void ComboBuffer::WriteRaw(int idx, int count, const RGBColor* src) {
+    int segnum = iPixelSegments[idx];
+    while (count > 0) {
+        const Segment_t& seg = iSegments[segnum++];
+        int num = min(count, seg.start + seg.count - idx);
+        seg.buffer->WriteRaw(idx - seg.start, num, src);
+        idx += num; src += num; count -= num;
+    }
+}
+
+void ComboBuffer::FillRaw(int idx, int count, const RGBColor& rgb) {
+    int segnum = iPixelSegments[idx];
+    while (count > 0) {
+        const Segment_t& seg = iSegments[segnum++];
+        int num = min(count, seg.start + seg.count - idx);
+        seg.buffer->FillRaw(idx - seg.start, num, rgb);
+        idx += num; count -= num;
     }
-    return LBuffer::kNullColor;
 }
 
 ComboBuffer::~ComboBuffer() {
@@ -53,16 +122,37 @@ void ComboBuffer::AddBuffers(const vector<LBuffer*>& buffers)
     int numBuffers = buffers.size() + iBuffers.size();
     iBuffers.reserve(numBuffers);
     iCounts.reserve(numBuffers);
+    iSegments.reserve(numBuffers);
     for (size_t i = 0; i < buffers.size(); ++i)
         AddBuffer(buffers[i]);
 }
 
+void ComboBuffer::AddSegment(LBuffer* buffer, int start, int count)
+{
+    if (count <= 0) return;
+    Segment_t seg;
+    seg.buffer = buffer;
+    seg.start  = start;
+    seg.count  = count;
+    iSegments.push_back(seg);
+    iPixelSegments.resize(start + count, iSegments.size() - 1);
+}
+
 void ComboBuffer::AddBuffer(LBuffer* buffer)
 {
     int count = buffer->GetCount();
+    ComboBuffer* combo = dynamic_cast<ComboBuffer*>(buffer);
+    if (combo) {
+        for (size_t i = 0; i < combo->iSegments.size(); ++i) {
+            const Segment_t& seg = combo->iSegments[i];
+            AddSegment(seg.buffer, iCount + seg.start, seg.count);
+        }
+    } else
+        AddSegment(buffer, iCount, count);
     iBuffers.push_back(buffer);
     iCounts.push_back(count);
     iCount += count;
+    MapChanged();
 }
 
 #if 0
@@ -159,8 +249,12 @@ LBuffer* ComboBuffer::PopLastBuffer()
     if (iBuffers.size() == 0) return NULL;
     iCount -= iCounts.back();
     iCounts.pop_back();
+    while (!iSegments.empty() && iSegments.back().start >= iCount)
+        iSegments.pop_back();
+    iPixelSegments.resize(iCount);
     LBuffer* buffer = iBuffers.back();
     iBuffers.pop_back();
+    MapChanged();
     return buffer;
 }
 
@@ -24,7 +24,8 @@ public:
 
     virtual int     GetCount()      const {return iCount;}
     virtual string  GetDescriptor() const;
-    virtual bool    Update();
+    virtual bool    Update();           // Updates the buffers in parallel if --outputthreads is more than 1
+    virtual bool    CanUpdateAsync() const;
 
     // Used by L::CreateOutputBuffer
     int GetNumBuffers() const {return iBuffers.size();}
@@ -32,13 +33,28 @@ public:
 
 protected:
     virtual RGBColor&   GetRawRGB(int idx);
+    virtual RGBColor*   GetRawSpan(int idx, int count);
+    virtual void        ReadRaw (int idx, int count, RGBColor* dest);
+    virtual void        WriteRaw(int idx, int count, const RGBColor* src);
+    virtual void        FillRaw (int idx, int count, const RGBColor& rgb);
     void AddBuffer(LBuffer*);
     void AddBuffers(const vector<LBuffer*>& buffers);
 
 private:
+    // Pixels are routed using a flat table of segments. Nested ComboBuffers are flattened into their own segments.
+    struct Segment_t {
+        LBuffer*    buffer;
+        int         start;  // Index of the first pixel of buffer in this ComboBuffer
+        int         count;
+    };
+
     int              iCount;
     vector<int>      iCounts;
     vector<LBuffer*> iBuffers;
+    vector<Segment_t> iSegments;
+    vector<int>      iPixelSegments; // Index into iSegments for every pixel
+
+    void AddSegment(LBuffer* buffer, int start, int count);
 };
 
 #endif // !COMBOBUFFER_H_INCLUDED
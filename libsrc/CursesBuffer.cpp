@@ -89,11 +89,11 @@ chtype RGBColorToCursesChar(const RGBColor& color) {
 }
 
 
-bool CursesBuffer::Update() {
+bool CursesBuffer::Transmit(const RGBColor* colors, int count) {
     MaybeInitializeCurses();
     move(gBegYoffset, 0);
-    for (iterator i = begin(); i != end(); ++i) {
-        addch(RGBColorToCursesChar(*i));
+    for (int i = 0; i < count; ++i) {
+        addch(RGBColorToCursesChar(colors[i]));
     }
     // Move the cursor out of the way and
     move(0,0);
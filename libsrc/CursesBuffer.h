@@ -17,7 +17,10 @@ public:
     virtual ~CursesBuffer() {}
 
     virtual string  GetDescriptor() const;
-    virtual bool    Update();
+    virtual bool    CanUpdateAsync() const  {return false;}
+
+protected:
+    virtual bool    Transmit(const RGBColor* colors, int count);
 
 private:
     // Don't allow copying
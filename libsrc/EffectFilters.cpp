@@ -5,6 +5,7 @@
 #include "EffectFilters.h"
 #include "utilsParse.h"
 #include "utilsRandom.h"
+#include <algorithm>
 
 void ForceLinkEffectFilters() {} // This is referenced in LFilters.cpp to force the link of this file into all binaries
 
@@ -28,15 +29,10 @@ string PlaneNavigationFilter::GetDescriptor() const
 bool PlaneNavigationFilter::Update()
  {
    // Force beginning to be red and end to be green
-   RGBColor green(GREEN);
-   RGBColor red(RED);
    int count = iBuffer->GetCount();
-   int stoppos = min(iNumPixels, count);
-   for (int i = 0; i < stoppos; ++i)
-     iBuffer->SetRGB(i, red);
-   stoppos = max(count-iNumPixels,0);
-   for (int i = count-1; i >= stoppos;--i)
-     iBuffer->SetRGB(i, green);
+   int width = min(iNumPixels, count);
+   iBuffer->FillRGB(0, width, RED);
+   iBuffer->FillRGB(count - width, width, GREEN);
    return iBuffer->Update();
  }
 
@@ -73,11 +69,6 @@ const float kDefaultSparkleSigma = 0.3;
 const float kDefaultSparkleDuration = 0.02; // Sparkles generally turn on for just a single frame
 
 
-SparkleFilter::~SparkleFilter() {
-  if (iState) delete[] iState; iState = NULL; 
-  if (iTimeToChange) delete[] iTimeToChange; iTimeToChange = NULL;
-}
-
 string SparkleFilter::GetDescriptor() const
 {
   return "sparkle(" + iColor.ToString() + "," + FltToStr(iOnFraction) + "," + FltToStr(iOnDuration) + "," + FltToStr(iSigma) + ")";
@@ -103,12 +94,27 @@ Milli_t SparkleFilter::GetSparkleDuration(bool newState)
 }
 
 void SparkleFilter::InitializeArrays() {
-  int     count = GetCount();
-  iState  = new bool[count];
-  iTimeToChange = new Milli_t[count];
+  iChanges.clear();
+  iLit.clear();
+  iLitPos.assign(GetCount(), -1);
   iPixelsNeedInit = true;
 }
 
+void SparkleFilter::SetPixel(int idx, bool state) {
+  int pos = iLitPos[idx];
+  if (state && pos < 0) {
+    iLitPos[idx] = iLit.size();
+    iLit.push_back(idx);
+  } else if (! state && pos >= 0) {
+    // Move the last lit pixel into this one's place
+    int last = iLit.back();
+    iLit[pos] = last;
+    iLitPos[last] = pos;
+    iLit.pop_back();
+    iLitPos[idx] = -1;
+  }
+}
+
 SparkleFilter::SparkleFilter() : LFilter(), iColor(WHITE), iPixelsNeedInit(true)
 {
   SetParameters(kDefaultSparkleFraction, kDefaultSparkleDuration, kDefaultSparkleSigma);
@@ -118,11 +124,13 @@ void SparkleFilter::InitializePixels()
 {
   int     count = GetCount();
   float   totalDuration = iOnDuration + iOffDuration;
+  InitializeArrays();
   for (int i = 0; i < count; ++i) {
     bool state = RandomFloat(totalDuration) < iOnDuration;
-    iState[i] = state;
-    iTimeToChange[i] = L::gStartTime + GetSparkleDuration(state)/2;
+    SetPixel(i, state);
+    iChanges.push_back(Change(L::gStartTime + GetSparkleDuration(state)/2, i));
   }
+  make_heap(iChanges.begin(), iChanges.end());
   iPixelsNeedInit = false;
 }
 
@@ -130,18 +138,19 @@ bool SparkleFilter::Update()
 {
   if (iPixelsNeedInit) InitializePixels();
 
-  int     count = GetCount();
-  for (int i = 0; i < count; ++i) {
-    // Update the states as necessary
-    if (L::gTime > iTimeToChange[i])
-      {
-    	 iState[i] = !iState[i];
-	     iTimeToChange[i] = L::gTime + GetSparkleDuration(iState[i]);
-      }
-    // If the light is sparkled, set it to the sparkle color
-    if (iState[i])
-      iBuffer->SetRGB(i, iColor);
+  // Flip the pixels whose time has come. Their next change is always at or after gTime so this terminates.
+  while (! iChanges.empty() && MilliLT(iChanges.front().time, L::gTime)) {
+    pop_heap(iChanges.begin(), iChanges.end());
+    Change& change = iChanges.back();
+    bool state = iLitPos[change.idx] < 0;
+    SetPixel(change.idx, state);
+    change.time = L::gTime + GetSparkleDuration(state);
+    push_heap(iChanges.begin(), iChanges.end());
   }
+
+  // Set the sparkled lights to the sparkle color
+  for (size_t i = 0; i < iLit.size(); ++i)
+    iBuffer->SetRGB(iLit[i], iColor);
   return iBuffer->Update();
 }
 
@@ -179,7 +188,7 @@ DEFINE_LBUFFER_FILTER_TYPE(sparkle, SparkleFilterCreate, "sparkle([color],[frac]
 // GradientColorFilter
 //-----------------------------------------------------------------------------
 // This filter just writes a color wash to iBuffer when Update is called
-const RGBColor GradientColorFilter::kDefaultColor(RED);
+const RGBColorObj GradientColorFilter::kDefaultColor(RED);
 
 void GradientColorFilter::SetColors(const Color* color1, const Color* color2) {
   if (color1) iColor1 = color1->AllocateCopy(); else iColor1 = kDefaultColor.AllocateCopy();
@@ -199,9 +208,8 @@ void GradientColorFilter::SetBuffer(LBuffer* buffer) {
 }
 
 bool GradientColorFilter::Update() {
-  int len = GetCount();
-  for (int i = 0; i < len; ++i) 
-    iBuffer->SetRGB(i, iColorBuffer[i]);
+  int len = min(GetCount(), (int) iColorBuffer.size());
+  if (len > 0) iBuffer->SetRGBs(0, len, &iColorBuffer[0]);
   return iBuffer->Update();
 }
 
@@ -210,7 +218,7 @@ bool GradientColorFilter::Update() {
 //-----------------------------------------------------------------------------
 // This filter just writes a color wash to iBuffer when Update is called
 
-const RGBColor SolidColorFilter::kDefaultColor(WHITE);
+const RGBColorObj SolidColorFilter::kDefaultColor(WHITE);
 
 void SolidColorFilter::SetColor(const Color* color) {
   if (color) iColor = color->AllocateCopy(); 
@@ -222,8 +230,6 @@ string SolidColorFilter::GetDescriptor() const {
 }
 
 bool SolidColorFilter::Update() {
-  int len = GetCount();
-  for (int i = 0; i < len; ++i) 
-    iBuffer->SetRGB(i, *iColor);
+  iBuffer->FillRGB(0, GetCount(), RGBColor(*iColor));
   return iBuffer->Update();
 }
@@ -25,6 +25,11 @@ public:
 
 protected:
   virtual RGBColor&   GetRawRGB(int idx);
+  // The visible pixels are contiguous in iBuffer so bulk access is just offset
+  virtual RGBColor*   GetRawSpan(int idx, int count)                {return LFilter::GetRawSpan(idx + iNumPixels, count);}
+  virtual void        ReadRaw (int idx, int count, RGBColor* dest)        {LFilter::ReadRaw (idx + iNumPixels, count, dest);}
+  virtual void        WriteRaw(int idx, int count, const RGBColor* src)   {LFilter::WriteRaw(idx + iNumPixels, count, src);}
+  virtual void        FillRaw (int idx, int count, const RGBColor& rgb)   {LFilter::FillRaw (idx + iNumPixels, count, rgb);}
 
 private:
   int 	     iNumPixels;
@@ -34,12 +39,14 @@ private:
 // SparkleFilter
 //-----------------------------------------------------------------------------
 // Introduces sparkles into the rendering pipeline
+// Each pixel's next on/off change is kept in a queue ordered by time, so each frame only looks at the pixels that
+// change plus the ones that are lit.
 
 class SparkleFilter : public LFilter
 {
 public:
   SparkleFilter();
-  virtual ~SparkleFilter();
+  virtual ~SparkleFilter() {}
 
   virtual void    SetBuffer(LBuffer* buffer) {LFilter::SetBuffer(buffer); InitializeArrays();}
   virtual string  GetDescriptor() const;
@@ -53,12 +60,21 @@ private:
   float      iOnDuration;     // Time that a pixel should be on
   float      iOffDuration;    // Time between a single pixel's sparkle
   float      iSigma;          // Std. deviation of the on/off time (scale by duration)
-  bool       iPixelsNeedInit; // true when iState needs initialization
-  bool*      iState;
-  Milli_t*   iTimeToChange;
+  bool       iPixelsNeedInit; // true when the pixels need initialization
+
+  struct Change {
+    Change(Milli_t t, int i) : time(t), idx(i) {}
+    Milli_t time;
+    int     idx;
+    bool operator<(const Change& c) const {return MilliLT(c.time, time);} // Makes the earliest change the top of the heap
+  };
+  vector<Change> iChanges;      // Heap with one entry per pixel
+  vector<int>    iLit;          // Pixels that are on
+  vector<int>    iLitPos;       // Position of each pixel in iLit or -1 if it's off
   Milli_t    GetSparkleDuration(bool newState);
   void       InitializeArrays();
   void       InitializePixels();
+  void       SetPixel(int idx, bool state);
 };
 
 //-----------------------------------------------------------------------------
@@ -85,7 +101,7 @@ private:
 class GradientColorFilter : public LFilter
 {
 public:
-  static const RGBColor kDefaultColor;
+  static const RGBColorObj kDefaultColor;
   GradientColorFilter(const Color* color1 = &kDefaultColor, const Color* color2 = &kDefaultColor) : LFilter() {SetColors(color1, color2);}
   virtual ~GradientColorFilter() {delete iColor1; delete iColor2;}
   virtual void SetColors(const Color* color1, const Color* color2);
@@ -106,7 +122,7 @@ private:
 class SolidColorFilter : public LFilter
 {
 public:
-  static const RGBColor kDefaultColor;
+  static const RGBColorObj kDefaultColor;
   SolidColorFilter(const Color* color = &kDefaultColor) : LFilter() {SetColor(color);}
   virtual ~SolidColorFilter() {if (iColor) delete iColor;}
   virtual void SetColor(const Color* color);
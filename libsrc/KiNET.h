@@ -120,7 +120,7 @@ struct KiNETportInfo : public KiNETheader
 // The reply to the above discovery packet
 struct KiNETportInfoReply : public KiNETheader
 {
-    KiNETportInfoReply() : KiNETheader(KTYPE_PORT_INFO_REPLY) {char* ptr = (char*) this + sizeof(KiNETheader); size_t len = sizeof(KiNETdiscoverReply) - sizeof(KiNETheader); memset(ptr, 0, len);}
+    KiNETportInfoReply() : KiNETheader(KTYPE_PORT_INFO_REPLY) {char* ptr = (char*) this + sizeof(KiNETheader); size_t len = sizeof(KiNETportInfoReply) - sizeof(KiNETheader); memset(ptr, 0, len);}
     static int GetSize() {return sizeof(KiNETportInfoReply);}
     uint32 numPorts;     // The number of KiNETportInfoData structures
     // This is followed by KiNETportInfoData structures
@@ -208,7 +208,7 @@ struct KiNETblinkScan2 : public KiNETheader
 // The reply to the above poll packet (this is sent by the PDS)
 struct KiNETblinkScan2Reply : public KiNETheader
 {
-    KiNETblinkScan2Reply() : KiNETheader(KTYPE_BLINK_SCAN2_REPLY) {char* ptr = (char*) this + sizeof(KiNETheader); size_t len = sizeof(KiNETdiscoverReply) - sizeof(KiNETheader); memset(ptr, 0, len);}
+    KiNETblinkScan2Reply() : KiNETheader(KTYPE_BLINK_SCAN2_REPLY) {char* ptr = (char*) this + sizeof(KiNETheader); size_t len = sizeof(KiNETblinkScan2Reply) - sizeof(KiNETheader); memset(ptr, 0, len);}
     static int GetSize() {return sizeof(KiNETblinkScan2Reply);}
     typedef enum {kStart = 0x0101, kEnd = 0x0001, kData = 0x0102 } replyType_t;
     uint16  replyType;
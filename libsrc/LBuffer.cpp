@@ -5,24 +5,33 @@
 #include "ComboBuffer.h"
 #include "utilsParse.h"
 #include "LFilter.h"
+#include "OutputThread.h"
 #include <vector>
+#include <algorithm>
 
 RGBColor LBuffer::kNullColor = BLACK; // note that this is used by functions returning references to colors
+int      LBuffer::gMapGeneration = 0;
 
 void LBufferPhys::Alloc(int count)
 {
   iBuffer.resize(count);
+  MapChanged(); // The storage may have moved
+}
+
+bool LBufferPhys::Update()
+{
+    if (CanUpdateAsync() && OutputThread::IsFrameOpen()) {
+        iFrontBuffer = iBuffer;
+        OutputThread::Queue(this);
+        return !HasError();
+    }
+    return Transmit(iBuffer.empty() ? NULL : &iBuffer[0], iBuffer.size());
 }
 
 void LBuffer::SetAll(const Color& color)
 {
     RGBColor rgb(color);
-    iterator iter = begin();
-    iterator endIter = end();
-    while (iter != endIter) {
-        *iter = rgb;
-        ++iter;
-    }
+    FillRaw(0, GetCount(), rgb);
 }
 
 void LBuffer::SetColor(int idx, const Color& color)
@@ -31,6 +40,84 @@ void LBuffer::SetColor(int idx, const Color& color)
     SetRGB(idx, rgb);
 }
 
+//----------------------------------------------------------------------------------------------------------------
+// Bulk access
+//----------------------------------------------------------------------------------------------------------------
+
+// Clips start and count to the buffer. Skipped is set to the number of pixels removed from the beginning. Returns false if nothing is left.
+bool LBuffer::ClipRange(int* start, int* count, int* skipped) const
+{
+    int len = GetCount();
+    int skip = 0;
+    if (*start < 0) {skip = -*start; *count += *start; *start = 0;}
+    if (*start + *count > len) *count = len - *start;
+    if (skipped) *skipped = skip;
+    return *count > 0;
+}
+
+void LBuffer::GetRGBs(int start, int count, RGBColor* dest) const
+{
+    int skipped;
+    if (ClipRange(&start, &count, &skipped))
+        const_cast<LBuffer*>(this)->ReadRaw(start, count, dest + skipped);
+}
+
+void LBuffer::SetRGBs(int start, int count, const RGBColor* src)
+{
+    int skipped;
+    if (ClipRange(&start, &count, &skipped))
+        WriteRaw(start, count, src + skipped);
+}
+
+void LBuffer::FillRGB(int start, int count, const RGBColor& rgb)
+{
+    if (ClipRange(&start, &count))
+        FillRaw(start, count, rgb);
+}
+
+void LBuffer::ScaleRGB(int start, int count, float scale)
+{
+    if (! ClipRange(&start, &count)) return;
+    RGBColor* span = GetRawSpan(start, count);
+    if (span)
+        for (int i = 0; i < count; ++i) span[i] *= scale;
+    else
+        for (int i = 0; i < count; ++i) GetRawRGB(start + i) *= scale;
+}
+
+RGBColor* LBuffer::GetSpan(int start, int count)
+{
+    if (start < 0 || count <= 0 || start + count > GetCount()) return NULL;
+    return GetRawSpan(start, count);
+}
+
+void LBuffer::ReadRaw(int idx, int count, RGBColor* dest)
+{
+    const RGBColor* span = GetRawSpan(idx, count);
+    if (span)
+        copy(span, span + count, dest);
+    else
+        for (int i = 0; i < count; ++i) dest[i] = GetRawRGB(idx + i);
+}
+
+void LBuffer::WriteRaw(int idx, int count, const RGBColor* src)
+{
+    RGBColor* span = GetRawSpan(idx, count);
+    if (span)
+        copy(src, src + count, span);
+    else
+        for (int i = 0; i < count; ++i) GetRawRGB(idx + i) = src[i];
+}
+
+void LBuffer::FillRaw(int idx, int count, const RGBColor& rgb)
+{
+    RGBColor* span = GetRawSpan(idx, count);
+    if (span)
+        fill(span, span + count, rgb);
+    else
+        for (int i = 0; i < count; ++i) GetRawRGB(idx + i) = rgb;
+}
+
 string LBuffer::GetDescription() const {
     string r = "LBuffer(";
     r += IntToStr(GetCount()) + " lights) ";
@@ -13,6 +13,7 @@
 //   filter/device ::= <name> or <name>:<arg1> or <name>(<arg1>,<arg2>,..,argN)
 
 class LFilter; //fwd decl
+namespace OutputThread {class Sender;};
 
 class LBuffer
     {
@@ -28,9 +29,16 @@ class LBuffer
     static LBuffer* Create(csref descriptor, string* errmsg = NULL);
     static RGBColor kNullColor;
 
+    // Incremented whenever any buffer changes which pixel storage its indices refer to (see MapChanged).
+    // Used by the output pipeline to know when its cached routing table is stale.
+    static int  GetMapGeneration()      {return gMapGeneration;}
+
     // Properties
     virtual int GetCount(void)          const = 0; // Must be defined
     bool        InBounds(int coord)     const {return coord >= 0 && coord < GetCount();}
+    // 2D geometry. Pixels are in row-major order, so pixel (x,y) is at index y*GetWidth()+x. Strips are one row.
+    virtual int GetWidth(void)          const {return GetCount();}
+    virtual int GetHeight(void)         const {return 1;}
 
     // Reads
     RGBColor    GetRGB(int coord)       const {if (InBounds(coord)) return const_cast<LBuffer*>(this)->GetRawRGB(coord); else return BLACK;}
@@ -38,15 +46,25 @@ class LBuffer
     // Writes
     void SetColor(int coord, const Color& color);
     void SetAll(const Color& color);
+    void SetAll(const RGBColor& rgb)              {FillRGB(0, GetCount(), rgb);}
     void SetRGB(int coord, const RGBColor& rgb)   {if (InBounds(coord)) GetRawRGB(coord) = rgb;}
     void AddRGB(int coord, const RGBColor& rgb)   {SetRGB(coord, GetRGB(coord) + rgb);}
 
+    // Bulk access. Ranges are clipped to the buffer. Much faster than calling GetRGB/SetRGB on each pixel.
+    void        GetRGBs(int start, int count, RGBColor* dest) const;
+    void        SetRGBs(int start, int count, const RGBColor* src);
+    void        FillRGB(int start, int count, const RGBColor& rgb);
+    void        ScaleRGB(int start, int count, float scale);    // Multiplies each pixel by scale
+    // Returns a writable pointer to count contiguous pixels starting at start or NULL if they aren't stored contiguously
+    RGBColor*   GetSpan(int start, int count);
+
     // Things to be overridden by the specific output class
     virtual bool    HasError()          const {return !iLastError.empty();}
     virtual string  GetLastError()      const {return iLastError;}
     virtual string  GetDescriptor()     const = 0; // Returns a descriptor of the LBuffer that can be used to recreate the exact LBuffer
     virtual string  GetDescription()    const; // returns a detailed description of the CKbuffer
     virtual bool    Update() = 0;              // Updates the actual device based on the buffer contents.  Must be supplied for all derived types.
+    virtual bool    CanUpdateAsync()    const {return true;} // Return false if the device must be updated from the main thread (e.g., windows)
     virtual void    Clear(void)         {SetAll(BLACK);}
 
     virtual ~LBuffer() {}
@@ -56,14 +74,29 @@ class LBuffer
 
     string              iLastError;
 
+    // Must be called whenever the mapping from indices to pixel storage changes (e.g., a filter's map or buffer changes)
+    static void         MapChanged()    {++gMapGeneration;}
+
     // Buffer access functions. Idx assumed to be in bounds.
+    // The returned reference must remain valid until MapChanged is called since the output pipeline caches it.
     virtual RGBColor&   GetRawRGB(int idx) = 0;
     RGBColor&           GetRGBRef(int coord)             {if (InBounds(coord)) return GetRawRGB(coord); else return kNullColor;}
 
+    // Bulk access functions. Range assumed to be in bounds.
+    // GetRawSpan returns NULL if the range isn't stored contiguously. The default Read/Write/Fill use a span if there is one, otherwise GetRawRGB.
+    virtual RGBColor*   GetRawSpan(int idx, int count)                  {return NULL;}
+    virtual void        ReadRaw (int idx, int count, RGBColor* dest);
+    virtual void        WriteRaw(int idx, int count, const RGBColor* src);
+    virtual void        FillRaw (int idx, int count, const RGBColor& rgb);
+    bool                ClipRange(int* start, int* count, int* skipped = NULL) const;
+
     // Disallow copy construction because it doesn't work reliably for the derived class
     LBuffer(const LBuffer&);
     LBuffer& operator=(const LBuffer&);
 
+  private:
+    static int          gMapGeneration;
+
   public:
     // Iterators
     class iterator
@@ -128,22 +161,31 @@ class LBufferPhys : public LBuffer
     virtual         ~LBufferPhys() {}
     // Properties
     int             GetCount(void)      const   {return iBuffer.size();}
-    virtual bool    Update() = 0;              // Updates the actual device based on the buffer contents.  Must be supplied for all derived types.
+    virtual bool    Update();                  // Transmits the buffer, or queues a copy for the output thread if it's running (see OutputThread.h)
 
   protected:
     LBufferPhys(int count = 0) : iBuffer(count) {}
 
     vector<RGBColor>    iBuffer;
 
+    // Updates the actual device with count colors.  Must be supplied for all derived types.
+    virtual bool    Transmit(const RGBColor* colors, int count) = 0;
+
     //$$$ Temporary  this needs to go away to be replaced by the ComboBuffer
     void        Alloc(int count); // erases the old buffer
 
     // Functions for writing directly to the buffer
     virtual RGBColor& GetRawRGB(int idx)        {return iBuffer[idx];}
+    virtual RGBColor* GetRawSpan(int idx, int count) {return &iBuffer[idx];}
 
     // Disallow copy construction because it doesn't work reliably for the derived class
     LBufferPhys(const LBuffer&);
     LBufferPhys& operator=(const LBuffer&);
+
+  private:
+    friend class OutputThread::Sender;
+    vector<RGBColor>    iFrontBuffer;   // Copy of iBuffer being sent by the output thread
+    bool            TransmitFront()     {return Transmit(iFrontBuffer.empty() ? NULL : &iFrontBuffer[0], iFrontBuffer.size());}
     };
 
 // Used to define the derived classes that LBuffer::Create knows how to make
@@ -22,19 +22,29 @@ public:
     static LFilter* Create(csref desc, string* errmsg);
 
     // Set the buffer that is the target of this filter instance
-    virtual void    SetBuffer(LBuffer* buffer) {iBuffer = buffer;}
+    virtual void    SetBuffer(LBuffer* buffer) {iBuffer = buffer; MapChanged();}
     LBuffer* GetBuffer() const {return iBuffer;}
 
     // Required definitions from LBuffer
     virtual int     GetCount() const {return iBuffer ? iBuffer->GetCount() : 0;}
+    // Keeps the geometry of iBuffer unless the filter changes the number of pixels
+    virtual int     GetWidth() const  {return HasBufferGeometry() ? iBuffer->GetWidth()  : GetCount();}
+    virtual int     GetHeight() const {return HasBufferGeometry() ? iBuffer->GetHeight() : 1;}
     virtual bool    Update() {return iBuffer ? iBuffer->Update() : false;}
+    virtual bool    CanUpdateAsync() const {return iBuffer ? iBuffer->CanUpdateAsync() : true;}
     virtual void    Clear() {if (iBuffer) iBuffer->Clear();}
     virtual string  GetDescription() const {return GetDescriptor() + "|" + (iBuffer ? iBuffer->GetDescription() : "(empty)");}
     // Note that the derived class requires GetDescriptor
 
 protected:
     virtual RGBColor& GetRawRGB(int idx) {return iBuffer->GetRawRGB(idx);} // Don't need to check if iBuffer exists on this one
+    // Bulk access passes straight through since the default filter doesn't remap
+    virtual RGBColor* GetRawSpan(int idx, int count)                {return iBuffer->GetRawSpan(idx, count);}
+    virtual void      ReadRaw (int idx, int count, RGBColor* dest)        {iBuffer->ReadRaw(idx, count, dest);}
+    virtual void      WriteRaw(int idx, int count, const RGBColor* src)   {iBuffer->WriteRaw(idx, count, src);}
+    virtual void      FillRaw (int idx, int count, const RGBColor& rgb)   {iBuffer->FillRaw(idx, count, rgb);}
     LBuffer* iBuffer;
+    bool     HasBufferGeometry() const {return iBuffer && iBuffer->GetCount() == GetCount();}
 };
 
 #endif // !LFILTER_H_INCLUDED
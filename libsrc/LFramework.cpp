@@ -2,12 +2,16 @@
 #include "Color.h"
 #include "LFramework.h"
 #include "ComboBuffer.h"
+#include "MapFilters.h"
 #include "Lproc.h"
 #include "utilsOptions.h"
 #include "Lobj.h"
 #include "utilsStats.h"
+#include "utilsPool.h"
 #include "LFilter.h"
+#include "OutputThread.h"
 #include <iostream>
+#include <map>
 
 namespace L {
 
@@ -24,6 +28,7 @@ Milli_t     gFrameDuration  = 40;    // duration of each frame of animation (in
 
 // Public list of procs
 LprocList       gProcs;
+bool            gObjCallbackIsThreadSafe = false;
 
 // Publically visible output pipeline
 Pipeline        gOutput;
@@ -67,12 +72,15 @@ bool CtrlCHandler()
 class StatsBuffer : public LFilter
 {
 public:
-  StatsBuffer() : LFilter(), iIsFirstTime(true), iLastFrameTime(0) {}
+  StatsBuffer() : LFilter(), iLastHeapAllocs(BlockPool::GetNumHeapAllocs()), iIsFirstTime(true), iLastFrameTime(0) {}
   string GetDescriptor() const {return "VerboseStats";}
   virtual bool Update();
   const StatsCollector<long>& GetCollector() {return iCollector;}
+  const StatsCollector<long>& GetAllocCollector() {return iAllocCollector;}
 private:
   StatsCollector<long>  iCollector;
+  StatsCollector<long>  iAllocCollector;  // Heap allocations for pooled objects (e.g., Lobjs) per frame
+  int iLastHeapAllocs;
   bool iIsFirstTime;
   Milli_t iLastFrameTime;
 };
@@ -88,6 +96,9 @@ bool  StatsBuffer::Update()
     iCollector.Record(newTime - lastFrameTime);
     lastFrameTime = newTime;
   }
+  int heapAllocs = BlockPool::GetNumHeapAllocs();
+  iAllocCollector.Record(heapAllocs - iLastHeapAllocs);
+  iLastHeapAllocs = heapAllocs;
   return iBuffer->Update();
 }
 
@@ -178,6 +189,98 @@ string Pipeline::GetDescription() const {
         return GetDescriptor() + "> (no output buffer)";
 }
 
+// Walks the filter chain once per pixel and remembers where each one ended up
+void Pipeline::CompileRoutes() {
+    iRouteGeneration = GetMapGeneration();
+    if (iShift) iShift->iIsRouted = false;
+    iShift = NULL;
+    iShiftIndex.clear();
+    int count = GetCount();
+    iRoute.resize(count);
+    for (int i = 0; i < count; ++i)
+        iRoute[i] = &(LFilter::GetRawRGB(i));
+
+    iRouteBase = count > 0 ? iRoute[0] : NULL;
+    for (int i = 1; i < count && iRouteBase; ++i)
+        if (iRoute[i] != iRouteBase + i) iRouteBase = NULL;
+
+    CompileShiftRoutes();
+}
+
+// Routes to the pixels below the first shift in the chain and remembers which of them each pixel reaches at
+// offset 0. Leaves the routes alone if that can't be done (e.g., two pixels below the shift share storage).
+void Pipeline::CompileShiftRoutes() {
+    ShiftFilter* shift = NULL;
+    for (LFilter* filter = dynamic_cast<LFilter*>(iBuffer); filter && !shift; filter = dynamic_cast<LFilter*>(filter->GetBuffer()))
+        shift = dynamic_cast<ShiftFilter*>(filter);
+    if (! shift || shift->GetCount() == 0) return;
+
+    int len = shift->GetCount();
+    int offset = shift->GetOffset() % len;
+    if (offset < 0) offset += len;
+    vector<RGBColor*> below(len);
+    map<RGBColor*, int> belowIndex;
+    for (int j = 0; j < len; ++j) {
+        int k = (j + offset) % len;
+        below[k] = &(shift->GetRawRGB(j));
+        if (! belowIndex.insert(make_pair(below[k], k)).second) return;
+    }
+
+    vector<int> shiftIndex(iRoute.size());
+    bool isUnchanged = true;
+    for (size_t i = 0; i < iRoute.size(); ++i) {
+        map<RGBColor*, int>::const_iterator iter = belowIndex.find(iRoute[i]);
+        if (iter == belowIndex.end()) return;
+        shiftIndex[i] = (iter->second - offset + len) % len;
+        if (shiftIndex[i] != (int) i) isUnchanged = false;
+    }
+
+    iRoute.swap(below);
+    if (! isUnchanged) iShiftIndex.swap(shiftIndex);
+    iRouteBase = NULL;
+    iShift = shift;
+    iShift->iIsRouted = true;
+}
+
+int Pipeline::GetShiftOffset() const {
+    if (! iShift || iRoute.empty()) return 0;
+    int offset = iShift->GetOffset() % (int) iRoute.size();
+    return offset < 0 ? offset + iRoute.size() : offset;
+}
+
+void Pipeline::ReadRaw(int idx, int count, RGBColor* dest) {
+    CheckRoutes();
+    int offset = GetShiftOffset();
+    for (int i = 0; i < count; ++i) dest[i] = *iRoute[RouteIndex(idx + i, offset)];
+}
+
+void Pipeline::WriteRaw(int idx, int count, const RGBColor* src) {
+    CheckRoutes();
+    int offset = GetShiftOffset();
+    for (int i = 0; i < count; ++i) *iRoute[RouteIndex(idx + i, offset)] = src[i];
+}
+
+void Pipeline::FillRaw(int idx, int count, const RGBColor& rgb) {
+    CheckRoutes();
+    int offset = GetShiftOffset();
+    for (int i = 0; i < count; ++i) *iRoute[RouteIndex(idx + i, offset)] = rgb;
+}
+
+// The filters still run here on the render thread. Only the physical devices send from the output thread.
+bool Pipeline::Update() {
+    if (! OutputThread::IsRunning()) {
+        OutputThread::BeginTransmit();
+        bool success = LFilter::Update();
+        OutputThread::EndTransmit();
+        return success;
+    }
+    // Devices that can't update asynchronously (e.g., windows) still transmit inside LFilter::Update
+    bool success = OutputThread::BeginFrame();
+    success = LFilter::Update() && success;
+    OutputThread::EndFrame();
+    return success;
+}
+
 void InitializeOutputPipeline() { 
     LBuffer* lastBuffer = gOutputBuffer;
     for (int i = ((int) gFilters.size()) - 1; i >= 0; --i) {
@@ -185,6 +288,7 @@ void InitializeOutputPipeline() {
         lastBuffer = gFilters[i];
     }
     gOutput.SetBuffer(lastBuffer);
+    gOutput.CompileRoutes();
 }
 
 //---------------------------------------------------------------
@@ -199,6 +303,15 @@ string VerboseCallback(csref name, csref val) {
     }
 DefOptionBool(verbose, VerboseCallback, "enables verbose status messages");
 
+//------------
+bool        gAsyncOutput    = false;
+
+string AsyncCallback(csref name, csref val) {
+    gAsyncOutput = true;
+    return "";
+    }
+DefOptionBool(async, AsyncCallback, "sends each frame to the devices on a separate thread while the next frame is rendered");
+
 //------------
 
 string FilterCallback(csref name, csref valarg) {
@@ -295,6 +408,38 @@ string FadeCallback(csref name, csref val) {
 
 DefOption(fade, FadeCallback, "fadeduration", "sets the fade in and out in time seconds.", FadeDefaultCallback);
 
+//------------
+// Frame scheduling. Frames are run on a fixed grid of deadlines that starts when L::Run starts.
+// If a frame overruns, the next frame starts right away and the grid restarts from there. Any whole frames
+// that were missed are counted as skipped. With --catchup, frames instead run back to back until the original
+// schedule is met again.
+bool        gCatchUp        = false;
+Micro_t     gSpinMicros     = 0;    // Busy wait for this long before each deadline
+int         gNumFrames      = 0;
+int         gMissedDeadlines = 0;
+int         gSkippedFrames  = 0;
+
+string CatchUpCallback(csref name, csref val) {
+    gCatchUp = true;
+    return "";
+    }
+DefOptionBool(catchup, CatchUpCallback, "runs late frames back to back instead of skipping them");
+
+string SpinDefaultCallback(csref name) {
+    return IntToStr(gSpinMicros);
+    }
+
+string SpinCallback(csref name, csref val) {
+    int spin;
+    if (! StrToInt(val, &spin))
+        return "The --" + name + " parameter, " + val + ", was not an integer.";
+    if (spin < 0)
+        return "--" + name + " cannot be less than zero.";
+    gSpinMicros = spin;
+    return "";
+}
+DefOption(spin, SpinCallback, "microseconds", "busy waits for the end of each frame for better timing accuracy.", SpinDefaultCallback);
+
 //---------------------------------------------------------------
 // Startup
 //---------------------------------------------------------------
@@ -332,11 +477,15 @@ void ErrorExit(csref msg) {
         gStatsBuffer = new StatsBuffer();
         PrependFilter(gStatsBuffer);
     }
+
+    // Make gOutput usable right away (e.g., for its count). Run rebuilds it in case more filters are added.
+    InitializeOutputPipeline();
 }
 
 void Cleanup(bool eraseAtEnd)
 {
     CtrlCHandler::Delete(CtrlCHandler);
+    OutputThread::Stop();
     if (eraseAtEnd)
       {
         // Clear the lights
@@ -350,19 +499,53 @@ void Cleanup(bool eraseAtEnd)
 	   cout << "  Target time between frames: " << gFrameDuration << "ms" << endl;
 	   cout << "  Actual " << gStatsBuffer->GetCollector().GetSummaryString() << endl;
        cout << "  Samples: " << gStatsBuffer->GetCollector().GetSamplesString() << endl;
+       cout << "  Missed deadlines: " << gMissedDeadlines << " of " << gNumFrames << " frames";
+       if (gSkippedFrames > 0) cout << " (" << gSkippedFrames << " skipped)";
+       cout << endl;
+       cout << "Object Heap Allocations per Frame" << endl;
+       cout << "  " << gStatsBuffer->GetAllocCollector().GetSummaryString() << endl;
+       cout << "  Samples: " << gStatsBuffer->GetAllocCollector().GetSamplesString() << endl;
+       cout << "  Objects allocated from pools: " << BlockPool::GetNumPoolAllocs() << endl;
       }
 }
 
-void RunOnce(Lgroup& objGroup, GroupCallback_t groupfcn)
+// A group and its callback. Lgroups and LgroupSoAs have different callback types.
+class GroupAndCallback {
+public:
+    GroupAndCallback(Lgroup& group, GroupCallback_t fcn)       : iGroup(group), iFcn(fcn), iSoAFcn(NULL) {}
+    GroupAndCallback(LgroupSoA& group, SoAGroupCallback_t fcn) : iGroup(group), iFcn(NULL), iSoAFcn(fcn) {}
+    LgroupBase& GetGroup() const    {return iGroup;}
+    void        Callback() const {
+        if (iFcn)    iFcn(static_cast<Lgroup*>(&iGroup));
+        if (iSoAFcn) iSoAFcn(static_cast<LgroupSoA*>(&iGroup));
+    }
+private:
+    LgroupBase&         iGroup;
+    GroupCallback_t     iFcn;
+    SoAGroupCallback_t  iSoAFcn;
+};
+
+void RunOnce(const GroupAndCallback& group)
 {
   gTime = Milliseconds();
   gOutput.Clear();
-  if (groupfcn) groupfcn(&objGroup);
-  objGroup.RenderAll(gTime, gProcs, &gOutput);
+  group.Callback();
+  group.GetGroup().RenderAll(gTime, gProcs, &gOutput);
+  gProcs.ApplyFrameGain(gTime, &gOutput);
   gOutput.Update();
 }
 
-void Run(Lgroup& objGroup, L::ObjCallback_t objfcn, L::GroupCallback_t groupfcn)
+void RunOnce(Lgroup& objGroup, GroupCallback_t groupfcn)
+{
+  RunOnce(GroupAndCallback(objGroup, groupfcn));
+}
+
+void RunOnce(LgroupSoA& objGroup, SoAGroupCallback_t groupfcn)
+{
+  RunOnce(GroupAndCallback(objGroup, groupfcn));
+}
+
+void Run(const GroupAndCallback& group, L::ObjCallback_t objfcn)
 {
     // Now create the output pipeline (gOutput)
     InitializeOutputPipeline();
@@ -385,27 +568,66 @@ void Run(Lgroup& objGroup, L::ObjCallback_t objfcn, L::GroupCallback_t groupfcn)
 
     // If callback, install it
     if (objfcn) {
-        LprocFcn proc(objfcn);
+        LprocFcn proc(objfcn, gObjCallbackIsThreadSafe);
         gProcs.PrependProc(proc);
     }
 
     // From now on, only terminate using gTerminateNow flag
     CtrlCHandler::Add(CtrlCHandler);
 
+    if (gAsyncOutput && ! OutputThread::Start())
+        ErrorExit("Couldn't start the output thread.");
+
     // Main loop
+    // Deadlines are computed from the start of the schedule so that sleep and render jitter don't accumulate
+    Micro_t scheduleStart = Microseconds();
+    Milli_t scheduleFrameDuration = gFrameDuration;
+    uint32  frameNum = 0;
     while (! gTerminateNow) {
  
-	  RunOnce(objGroup, groupfcn);
+	  RunOnce(group);
+	  ++gNumFrames;
 
 	  Milli_t currentTime = Milliseconds();
 	  if (gEndTime != 0 && MilliLE(gEndTime, currentTime)) break;
-	  
-	  Milli_t elapsedSinceFrameStart = MilliDiff(currentTime, gTime);
-	  if (gFrameDuration > elapsedSinceFrameStart)
-		SleepMilli(gFrameDuration - elapsedSinceFrameStart);
+
+	  // Restart the schedule if the frame rate changed
+	  if (gFrameDuration != scheduleFrameDuration) {
+		scheduleStart += frameNum * scheduleFrameDuration * 1000;
+		scheduleFrameDuration = gFrameDuration;
+		frameNum = 0;
+	  }
+	  Micro_t frameMicros = scheduleFrameDuration * 1000;
+	  if (frameMicros == 0) continue; // As fast as possible
+
+	  ++frameNum;
+	  Micro_t deadline = scheduleStart + frameNum * frameMicros;
+	  int32 late = -MicroUntil(deadline);
+	  if (late > 0) {
+		++gMissedDeadlines;
+		if (! gCatchUp) {
+		  // Start the next frame now and schedule from here
+		  gSkippedFrames += late / frameMicros;
+		  scheduleStart = Microseconds();
+		  frameNum = 0;
+		  continue;
+		}
+	  }
+	  SleepUntilMicro(deadline, gSpinMicros);
     }
+
+    OutputThread::Stop();
 }
 
+void Run(Lgroup& objGroup, L::ObjCallback_t objfcn, L::GroupCallback_t groupfcn)
+{
+    Run(GroupAndCallback(objGroup, groupfcn), objfcn);
+}
+
+void Run(LgroupSoA& objGroup, L::ObjCallback_t objfcn, L::SoAGroupCallback_t groupfcn)
+{
+    Run(GroupAndCallback(objGroup, groupfcn), objfcn);
+}
 
 }; // namespace L
 
@@ -11,19 +11,50 @@
 #include "LFilter.h"
 #include "Lproc.h"
 
+class ShiftFilter;
+class LgroupBase;
 class Lgroup;
+class LgroupSoA;
 class Lobj;
 
 namespace L {
 // Rendering pipeline
 
+// The pipeline caches where each of its pixels is actually stored, so pixel access costs one table lookup
+// no matter how many filters and combos are in the chain. The table is rebuilt whenever a map changes.
+// Shifts (including rotate and bounce) change every frame, so the first one in the chain is applied here as a
+// rotation of the index into the table instead.
 class Pipeline : public LFilter
 {
 public:
-	Pipeline(LBuffer* buffer = NULL) : LFilter(buffer) {}
+	Pipeline(LBuffer* buffer = NULL) : LFilter(buffer), iRouteBase(NULL), iRouteGeneration(-1), iShift(NULL) {}
 	virtual ~Pipeline() {}
 	virtual string GetDescription() const;
 	virtual string GetDescriptor() const {return "OutputPipeline";}
+	virtual bool   Update();    // With --async, hands the frame to the output thread. Returns the result of the previous frame.
+	void CompileRoutes();   // Called automatically when needed
+
+protected:
+	virtual RGBColor& GetRawRGB(int idx)                            {CheckRoutes(); return *iRoute[RouteIndex(idx, GetShiftOffset())];}
+	virtual RGBColor* GetRawSpan(int idx, int count)                {CheckRoutes(); return iRouteBase ? iRouteBase + idx : NULL;}
+	virtual void      ReadRaw (int idx, int count, RGBColor* dest);
+	virtual void      WriteRaw(int idx, int count, const RGBColor* src);
+	virtual void      FillRaw (int idx, int count, const RGBColor& rgb);
+
+private:
+	vector<RGBColor*>   iRoute;             // Storage location of each pixel (with iShift, of each pixel below the shift)
+	RGBColor*           iRouteBase;         // Set if all of the pixels are stored contiguously and in order
+	int                 iRouteGeneration;   // Value of LBuffer::GetMapGeneration() when iRoute was compiled
+	ShiftFilter*        iShift;             // Shift whose offset is applied by RouteIndex. May be NULL.
+	vector<int>         iShiftIndex;        // Index of each pixel where it reaches iShift. Empty if it's unchanged.
+	void CheckRoutes() {if (iRouteGeneration != GetMapGeneration()) CompileRoutes();}
+	void CompileShiftRoutes();
+	int  GetShiftOffset() const;            // Between 0 and the size of iRoute
+	int  RouteIndex(int idx, int offset) const {
+		if (! iShift) return idx;
+		int j = (iShiftIndex.empty() ? idx : iShiftIndex[idx]) + offset;
+		return j < (int) iRoute.size() ? j : j - (int) iRoute.size();
+	}
 };
 
 extern Pipeline gOutput;
@@ -32,6 +63,8 @@ extern Pipeline gOutput;
 // --dev  // Output device
 // --verbose
 extern bool         gVerbose;
+// --async    Transmits frames on a separate thread (see OutputThread.h)
+extern bool         gAsyncOutput;
 // --time
 extern float        gRunTime;
 // --color
@@ -68,12 +101,18 @@ extern bool         gTerminateNow;
 // Standard loop functions
 typedef void (*ObjCallback_t)   (Lobj* obj);    // Called for each object during L::Run
 typedef void (*GroupCallback_t) (Lgroup* group);  // Called once for the group after the output is clear but before any of the objects are run
+typedef void (*SoAGroupCallback_t) (LgroupSoA* group);  // The same for array-based groups
+// Set this to true before calling Run if the ObjCallback only changes the object it's given. Then, with --renderthreads,
+// it may be called for different objects at the same time. Otherwise objects are all updated from the main thread.
+extern bool         gObjCallbackIsThreadSafe;
 
 // This handles all of the startup functions. minPositionalArgs may be kVariable if any number of positional args are allowed or you can specify a range. 
 // If maxPositionalArgs is not specified is defaulted to the value of minPositionalArgs
 void Startup(int *argc, char** argv, int minPositionalArgs = 0, int maxPositionalArgs = -1);
 void Run(Lgroup& objgroup, ObjCallback_t fcn = NULL, GroupCallback_t gfcn = NULL); // Delay between renders is based on gFrameDuration
+void Run(LgroupSoA& objgroup, ObjCallback_t fcn = NULL, SoAGroupCallback_t gfcn = NULL);
 void RunOnce(Lgroup& objgroup, GroupCallback_t gfcn = NULL);                // No delays built in
+void RunOnce(LgroupSoA& objgroup, SoAGroupCallback_t gfcn = NULL);
 void Cleanup(bool eraseAtEnd = false);
 
 void ErrorExit(csref message);
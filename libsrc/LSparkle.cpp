@@ -10,25 +10,78 @@
 // LSparkle member functions
 //----------------------------------------------------------------------
 
-RGBColor LSparkle::ComputeColor(const RGBColor& referenceColor, Milli_t currentTime) const {
-//    cout << "Color: " << referenceColor.ToString() << " start: " << startTime << " currentTime: " << currentTime << "  attack: " << attack << "  hold: " << hold << endl;
-
-    if (MilliGE(startTime, currentTime))
-        return BLACK;
-    else if (MilliGT(startTime + attack, currentTime))
-        return referenceColor * ((float)(currentTime - startTime) / attack);
-    else if (MilliGE(startTime + attack + hold, currentTime))
-        return referenceColor;
-    else if (MilliGT(startTime + attack + hold + release, currentTime))
-        return referenceColor * ((float) (release - (currentTime - startTime - attack - hold)) / release);
-    else
-        return BLACK;
+// A zero length attack or release is treated as a very steep one
+const float kMaxSlope = 1e9;
+
+float LSparkle::GetLevel(Milli_t currentTime) const {
+    int32 elapsed = (int32) (currentTime - startTime);  // Negative before the start, even across a wrap
+    if (elapsed <= 0)
+        return 0;
+    if (elapsed <= (int32) attack)
+        return (float) elapsed / attack;
+    int32 holdEnd = attack + hold;
+    if (elapsed < holdEnd)
+        return 1;
+    int32 releaseEnd = holdEnd + release;
+    if (elapsed <= releaseEnd && release > 0)
+        return (float) (releaseEnd - elapsed) / release;
+    return 0;
+}
+
+LSparkle::Envelope LSparkle::GetEnvelope() const {
+    Envelope env;
+    env.startTime    = startTime;
+    env.releaseEnd   = attack + hold + release;
+    env.attackSlope  = attack  > 0 ? 1.0F / attack  : kMaxSlope;
+    env.releaseSlope = release > 0 ? 1.0F / release : kMaxSlope;
+    return env;
+}
+
+// The level is the lower of the attack ramp and the release ramp, clamped to 0..1. Each ramp is above 1 during
+// the other's phase and during the hold, and one of them is negative before the start or after the release.
+void LSparkle::ComputeLevels(const Envelope* envelopes, int count, Milli_t currentTime, float* levels) {
+    for (int i = 0; i < count; ++i) {
+        const Envelope& env = envelopes[i];
+        float elapsed = (int32) (currentTime - env.startTime);
+        float level = min(elapsed * env.attackSlope, (env.releaseEnd - elapsed) * env.releaseSlope);
+        levels[i] = max(0.0F, min(level, 1.0F));
+    }
 }
 
 Milli_t LSparkle::GetEndTime() const {
     return startTime + attack + hold + release + sleep;
 }
 
+//----------------------------------------------------------------------
+// LgroupSparkle
+//----------------------------------------------------------------------
+
+void LgroupSparkle::Resize(int count) {
+    LgroupSoA::Resize(count);
+    iSparkles.resize(count);
+    iEnvelopes.resize(count, LSparkle().GetEnvelope());
+    iLevels.resize(count);
+}
+
+void LgroupSparkle::GetObj(int idx, Lobj* obj) const {
+    LgroupSoA::GetObj(idx, obj);
+    LobjSparkle* sobj = dynamic_cast<LobjSparkle*>(obj);
+    if (sobj) sobj->sparkle = iSparkles[idx];
+}
+
+void LgroupSparkle::SetObj(int idx, const Lobj& obj) {
+    LgroupSoA::SetObj(idx, obj);
+    const LobjSparkle* sobj = dynamic_cast<const LobjSparkle*>(&obj);
+    if (sobj) SetSparkle(idx, sobj->sparkle);
+}
+
+void LgroupSparkle::UpdateColorAll(Milli_t currentTime, int start, int end) {
+    if (start >= end) return;
+    LSparkle::ComputeLevels(&iEnvelopes[start], end - start, currentTime, &iLevels[start]);
+    for (int i = start; i < end; ++i)
+        renderColor[i] = color[i] * iLevels[i];
+}
+
 //bool LobjSparkle::IsOutOfTime() const {
 //    return sparkle.IsOutOfTime(lastTime);
 //}
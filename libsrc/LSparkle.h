@@ -11,6 +11,7 @@
 class LSparkle
 {
   friend class LobjSparkle;
+  friend class LgroupSparkle;
   public:
     LSparkle() : startTime(0), attack(0), hold(0), release(0), sleep(0) {}
     Milli_t startTime;
@@ -20,6 +21,20 @@ class LSparkle
     Milli_t sleep;
     // Operations
     bool        IsOutOfTime(Milli_t currentTime) const {return MilliLT(GetEndTime(), currentTime);}
+    float       GetLevel(Milli_t currentTime) const;   // Brightness from 0 to 1
+
+    // The brightness curve with the phase boundaries and slopes precomputed so that many sparkles can be evaluated
+    // in one loop without branches or divisions.
+    struct Envelope {
+        Envelope() : startTime(0), releaseEnd(0), attackSlope(0), releaseSlope(0) {}
+        Milli_t startTime;
+        int32   releaseEnd;     // Milliseconds from startTime to the end of the release
+        float   attackSlope;    // 1/attack
+        float   releaseSlope;   // 1/release
+    };
+    Envelope    GetEnvelope() const;
+    // Sets levels[i] to GetLevel(currentTime) for the sparkle that envelopes[i] came from
+    static void ComputeLevels(const Envelope* envelopes, int count, Milli_t currentTime, float* levels);
 
     // Creating Sparkles
     // Mode
@@ -32,7 +47,7 @@ class LSparkle
 
 private:
     Milli_t     GetEndTime() const;
-    RGBColor    ComputeColor(const RGBColor& referenceColor, Milli_t currentTime) const;
+    RGBColor    ComputeColor(const RGBColor& referenceColor, Milli_t currentTime) const {return referenceColor * GetLevel(currentTime);}
 };
 
 class LobjSparkle : public Lobj {
@@ -55,6 +70,29 @@ class LobjSparkle : public Lobj {
     virtual string GetTypeName() const {return "LobjSparkle";}
 };
 
+// Array-based version of a group of LobjSparkles (see LgroupSoA)
+class LgroupSparkle : public LgroupSoA {
+  public:
+    LgroupSparkle() : LgroupSoA() {}
+    virtual ~LgroupSparkle() {}
+
+    virtual void    Resize(int count);
+    virtual Lobj*   AllocObj() const {return new LobjSparkle();}
+    virtual void    GetObj(int idx, Lobj* obj) const;
+    virtual void    SetObj(int idx, const Lobj& obj);
+
+    const LSparkle& GetSparkle(int idx) const {return iSparkles[idx];}
+    void            SetSparkle(int idx, const LSparkle& sparkle) {iSparkles[idx] = sparkle; iEnvelopes[idx] = sparkle.GetEnvelope();}
+
+  protected:
+    virtual void    UpdateColorAll(Milli_t currentTime, int start, int end);
+
+  private:
+    vector<LSparkle>            iSparkles;
+    vector<LSparkle::Envelope>  iEnvelopes; // Kept in sync with iSparkles by SetSparkle
+    vector<float>               iLevels;    // Used by UpdateColorAll
+};
+
 namespace L {
 // Parser support
 // This defines the --sparkle option
@@ -2,106 +2,153 @@
 #include "Color.h"
 #include "LBuffer.h"
 #include "Lproc.h"
+#include "utilsThread.h"
+#include "utilsOptions.h"
 #include <math.h>
 #include <iostream>
 
 bool gAntiAlias = true;
 
-#define MAX_OBJS 100
-LobjOld gAllLobjOlds[MAX_OBJS];
-short gLobjOldCount = 0;
-
-void LobjOld::Clear() {
-  pos = 0;
-  color = BLACK;
-  speed = 0;
-  velocity = 0;
-}
-
-
-void LobjOld::Render(LBuffer* buffer) const {
-  if (! gAntiAlias) {
-    // No anti-aliasing
-    int bpos = pos + .5;
-    if (bpos < 0 || bpos >= buffer->GetCount()) return;
-    buffer->AddRGB(bpos, color);
-  } else {
-    float floorpos = floor(pos);
-    // High-level clip (avoid aliasing at extreme values)
-    if (floorpos <= -1.0 || floorpos >= (float) buffer->GetCount()) return;
-
-    float efrac = pos - floorpos;
-    float bfrac = 1.0 - efrac;
-    short bpos = floorpos;
-    short epos = bpos + 1;
-
-    RGBColor tcolor;
-    if (bfrac > 0 && bpos >= 0 && bpos < buffer->GetCount()) {
-      tcolor = color;
-      tcolor *= bfrac;
-      buffer->AddRGB(bpos, tcolor);
-     }
-
-    if (efrac > 0 && epos >= 0 && epos < buffer->GetCount()) {
-      tcolor = color;
-      tcolor *= efrac;
-      buffer->AddRGB(epos, tcolor);
+//----------------------------------------------------------------------
+// Options
+//----------------------------------------------------------------------
+int         gRenderThreads      = 1;
+ThreadPool* gRenderPool         = NULL;
+const int   kMinObjectsPerThread = 256;   // Fewer than this and a thread isn't worth waking up
+
+string RenderThreadsDefaultCallback(csref name) {
+    return IntToStr(gRenderThreads);
     }
-  }
+
+string RenderThreadsCallback(csref name, csref val) {
+    if (StrEQ(val, "auto")) {
+        gRenderThreads = NumberOfProcessors();
+        return "";
+    }
+    if (! StrToInt(val, &gRenderThreads))
+        return "The --" + name + " parameter, " + val + ", was not an integer or 'auto'.";
+    if (gRenderThreads < 1)
+        return "--" + name + " must be at least 1.";
+    return "";
 }
 
+DefOption(renderthreads, RenderThreadsCallback, "numthreads", "sets the number of threads used to update and render objects. 'auto' uses one per processor.", RenderThreadsDefaultCallback);
+
+//----------------------------------------------------------------------
+// Lframe
+//----------------------------------------------------------------------
 
-// Global Operations
-void LobjOld::RenderAll(LBuffer* buffer) {
-  for (int i = 0; i < gLobjOldCount; ++i) {
-    gAllLobjOlds[i].Render(buffer);
-  }
+void Lframe::Load(const LBuffer* buffer, bool is2D) {
+    int count = buffer->GetCount();
+    iWidth  = is2D ? buffer->GetWidth()  : count;
+    iHeight = is2D ? buffer->GetHeight() : 1;
+    if (iWidth * iHeight != count) {iWidth = count; iHeight = 1;}
+    iPixels.resize(count);
+    buffer->GetRGBs(0, count, GetPixels());
 }
 
-short LobjOld::GetNum(void) {
-  return gLobjOldCount;
+void Lframe::Store(LBuffer* buffer) const {
+    if (! iPixels.empty())
+        buffer->SetRGBs(0, iPixels.size(), &iPixels[0]);
 }
 
-short LobjOld::GetMaxNum(void) {
-  return MAX_OBJS;
+void Lframe::AddFrame(const Lframe& frame, int start, int end) {
+    if (start < 0) start = 0;
+    if (end > GetCount())       end = GetCount();
+    if (end > frame.GetCount()) end = frame.GetCount();
+    for (int i = start; i < end; ++i)
+        iPixels[i] += frame.iPixels[i];
 }
 
-LobjOld* LobjOld::GetNth(short index) {
-  if (index >= gLobjOldCount || index < 0) return 0;
-  return gAllLobjOlds + index;
+void Lframe::AddSpan(int start, int end, const RGBColor& rgb) {
+    if (start < 0) start = 0;
+    if (end > GetCount()) end = GetCount();
+    for (int i = start; i < end; ++i)
+        iPixels[i] += rgb;
 }
 
-LobjOld* LobjOld::Alloc(void) {
-  if (gLobjOldCount >= MAX_OBJS) return 0;
-  LobjOld* retval = &(gAllLobjOlds[gLobjOldCount++]);
-  retval->Clear();
-  return retval;
+void Lframe::AddObject(const Lxy& pos, float width, const RGBColor& rgb) {
+    if (iHeight > 1)
+        AddObject2D(pos, width, rgb);
+    else
+        AddObject1D(pos.x, width, rgb);
 }
 
-bool LobjOld::Free(LobjOld* lptr) {
-  int index = lptr - gAllLobjOlds;
-  if (index < 0 || index >= gLobjOldCount) return false;
-  for (int i = index; i < gLobjOldCount-1; ++i)
-    gAllLobjOlds[i] = gAllLobjOlds[i+1];
-  --gLobjOldCount;
-  return true;
+void Lframe::AddObject1D(float x, float width, const RGBColor& rgb) {
+    // Position is the middle of the object
+    if (width == 0 || !gAntiAlias) {
+        // Round to nearest pixel to beginning of object
+        int ipos = x - width/2.0 + .5;
+        int iwidth = width == 0? 1 : (width + .5);
+        AddSpan(ipos, ipos + iwidth, rgb);
+    } else {
+    // Non-zero width AND anti-aliasing.
+    float left = x - width / 2.0 + .5;  // The .5 insures that a light of width 1 displays as a single pixel
+    float lbound = floor(left);
+    float lfrac = 1.0 - (left - lbound);
+    int lpos = lbound;
+    float right = x + width / 2.0 - .5;
+    float rbound = ceil(right);
+    float rfrac = 1.0 - (rbound - right);
+    int rpos = rbound;
+    if (lpos == rpos) lfrac *= rfrac;  // May need more thought
+
+    // Write out first pixel
+    Add(lpos, rgb * lfrac);
+    // Write out middle pixels
+    AddSpan(lpos + 1, rpos, rgb);
+    // Write out last pixel
+    if (lpos != rpos)
+        Add(rpos, rgb * rfrac);
+    }
 }
 
-void LobjOld::Map(LobjOldMapFcn_t mapfcn) {
-  for (int i = 0; i < gLobjOldCount; ++i)
-    mapfcn(gAllLobjOlds + i);
+// Objects are squares and each pixel gets the fraction of its area that the object covers
+void Lframe::AddObject2D(const Lxy& pos, float width, const RGBColor& rgb) {
+    if (width == 0 || !gAntiAlias) {
+        int iwidth = width == 0? 1 : (width + .5);
+        int x0 = floor(pos.x - width/2.0 + .5), x1 = x0 + iwidth;
+        int y0 = floor(pos.y - width/2.0 + .5), y1 = y0 + iwidth;
+        x0 = max(x0, 0); x1 = min(x1, iWidth);
+        y0 = max(y0, 0); y1 = min(y1, iHeight);
+        for (int y = y0; y < y1; ++y) {
+            RGBColor* row = &iPixels[y * iWidth];
+            for (int x = x0; x < x1; ++x)
+                row[x] += rgb;
+        }
+        return;
+    }
+
+    // Pixel i covers i-.5 to i+.5
+    float left = pos.x - width/2, right  = pos.x + width/2;
+    float top  = pos.y - width/2, bottom = pos.y + width/2;
+    int x0 = max((int) floor(left + .5), 0), x1 = min((int) floor(right  + .5), iWidth  - 1);
+    int y0 = max((int) floor(top  + .5), 0), y1 = min((int) floor(bottom + .5), iHeight - 1);
+    if (x0 > x1 || y0 > y1) return;
+
+    // Horizontal coverage is the same for every row
+    iWeights.resize(x1 - x0 + 1);
+    for (int x = x0; x <= x1; ++x)
+        iWeights[x - x0] = min(right, x + .5F) - max(left, x - .5F);
+
+    for (int y = y0; y <= y1; ++y) {
+        RGBColor rowColor = rgb * (min(bottom, y + .5F) - max(top, y - .5F));
+        RGBColor* row = &iPixels[y * iWidth];
+        for (int x = x0; x <= x1; ++x)
+            row[x] += rowColor * iWeights[x - x0];
+    }
 }
 
 //----------------------------------------------------------------------
 // Lobj Update Loop
 //----------------------------------------------------------------------
 
-void Lobj::Update(Milli_t currentTime, const LprocList& procList, LBuffer* outputBuffer) {
+void Lobj::Update(Milli_t currentTime, const LprocList& procList, Lframe* frame) {
     UpdatePrepare(currentTime);
     UpdateMove();
     UpdateColor();
     UpdateProcs(procList);
-    UpdateRender(outputBuffer);
+    UpdateRender(frame);
     UpdateDone();
 }
 
@@ -118,38 +165,8 @@ void Lobj::UpdateProcs(const LprocList& procs) {
     procs.Apply(this);
 }
 
-void Lobj::UpdateRender(LBuffer* buffer) {
-    // Only supports 1D rendering at the moment
-    // Position is the middle of the object
-    //cout << "Render: " << rgb.ToString() << " at " << pos.x << "," << pos.y << endl;
-
-    if (width == 0 || !gAntiAlias) {
-        // Round to nearest pixel to beginning of object
-        int ipos = pos.x - width/2.0 + .5;
-        int iwidth = width == 0? 1 : (width + .5);
-        for (int i = 0; i < iwidth; ++i, ++ipos)
-            buffer->AddRGB(ipos, renderColor);
-    } else {
-    // Non-zero width AND anti-aliasing.
-    float left = pos.x - width / 2.0 + .5;  // The .5 insures that a light of width 1 displays as a single pixel
-    float lbound = floor(left);
-    float lfrac = 1.0 - (left - lbound);
-    int lpos = lbound;
-    float right = pos.x + width / 2.0 - .5;
-    float rbound = ceil(right);
-    float rfrac = 1.0 - (rbound - right);
-    int rpos = rbound;
-    if (lpos == rpos) lfrac *= rfrac;  // May need more thought
-
-    // Write out first pixel
-    buffer->AddRGB(lpos, renderColor * lfrac);
-    // Write out middle pixels
-    for (int ipos = lpos + 1; ipos < rpos; ++ipos)
-        buffer->AddRGB(ipos, renderColor);
-    // Write out last pixel
-    if (lpos != rpos)
-        buffer->AddRGB(rpos, renderColor * rfrac);
-    }
+void Lobj::UpdateRender(Lframe* frame) {
+    frame->AddObject(pos, width, renderColor);
 }
 
 //----------------------------------------------------------------------
@@ -192,7 +209,9 @@ string Lobj::GetDescription(bool verbose) const {
 
 
 void Lgroup::Add(Lobj* obj) {
-    if (obj) iObjs.push_back(obj);
+    if (! obj) return;
+    iObjs.push_back(obj);
+    obj->iGroupIndex.idx = iObjs.size() - 1;
 }
 
 void Lgroup::Add(int num, Lobj::AllocFcn_t fcn, const void* info) {
@@ -200,15 +219,31 @@ void Lgroup::Add(int num, Lobj::AllocFcn_t fcn, const void* info) {
         Add(fcn(i, info));
 }
 
-bool Lgroup::Free(Lobj* obj) {
-    for (iterator i = begin(); i != end(); ++i) {
-        if (*i == obj) {
-            iObjs.erase(i);
-            delete obj;
-            return true;
-        }
-    }
-    return false;
+// Returns the index of obj in this group or -1
+int Lgroup::FindIndex(const Lobj* obj) const {
+    int idx = obj->iGroupIndex.idx;
+    if (idx >= 0 && (size_t) idx < iObjs.size() && iObjs[idx] == obj)
+        return idx;
+    // The index is stale if the caller reordered the group through its iterators
+    for (size_t i = 0; i < iObjs.size(); ++i)
+        if (iObjs[i] == obj) return i;
+    return -1;
+}
+
+bool Lgroup::Free(Lobj* obj, bool keepOrder) {
+    if (! obj) return false;
+    int idx = FindIndex(obj);
+    if (idx < 0) return false;
+
+    int last = iObjs.size() - 1;
+    if (keepOrder) {
+        for (int i = idx; i < last; ++i)
+            SetIndex(i, iObjs[i+1]);
+    } else if (idx != last)
+        SetIndex(idx, iObjs[last]);
+    iObjs.pop_back();
+    delete obj;
+    return true;
 }
 
 void Lgroup::FreeAll() {
@@ -217,13 +252,30 @@ void Lgroup::FreeAll() {
     iObjs.clear();
 }
 
-void Lgroup::FreeIf(Lobj::FreeIfFcn_t fcn, const void* info) {
-    for (iterator i = begin(); i != end();) {
-        if (fcn(*i, info)) {
-            delete *i;
-            i = iObjs.erase(i);
-        } else
-            ++i;
+void Lgroup::FreeIf(Lobj::FreeIfFcn_t fcn, const void* info, bool keepOrder) {
+    if (keepOrder) {
+        // Slide the survivors down over the freed objects
+        size_t numKept = 0;
+        for (size_t i = 0; i < iObjs.size(); ++i) {
+            Lobj* obj = iObjs[i];
+            if (fcn(obj, info))
+                delete obj;
+            else
+                SetIndex(numKept++, obj);
+        }
+        iObjs.resize(numKept);
+    } else {
+        // Fill each hole with the last object (which still needs to be checked)
+        size_t i = 0;
+        while (i < iObjs.size()) {
+            Lobj* obj = iObjs[i];
+            if (fcn(obj, info)) {
+                delete obj;
+                if (i != iObjs.size() - 1) SetIndex(i, iObjs.back());
+                iObjs.pop_back();
+            } else
+                ++i;
+        }
     }
 }
 
@@ -232,13 +284,75 @@ void Lgroup::FreeIf(Lobj::FreeIfFcn_t fcn, const void* info) {
 // Common Lgroup functions
 LprocList gDummyProcList;
 
-void Lgroup::RenderAll(Milli_t currentTime, LBuffer* buffer) const {
+void LgroupBase::RenderAll(Milli_t currentTime, LBuffer* buffer) {
     RenderAll(currentTime, gDummyProcList, buffer);
 }
 
-void Lgroup::RenderAll(Milli_t currentTime, const LprocList& filters, LBuffer* buffer) const {
-    for (const_iterator i = begin(); i != end(); ++i)
-        (*i)->Update(currentTime, filters, buffer);
+int LgroupBase::GetRenderThreads(int count, const LprocList& procs) {
+    int numThreads = min(gRenderThreads, count / kMinObjectsPerThread);
+    if (numThreads <= 1 || ! procs.IsThreadSafe()) return 1;
+    if (! gRenderPool) gRenderPool = new ThreadPool(gRenderThreads);
+    return min(numThreads, gRenderPool->GetNumThreads());
+}
+
+// Used to split RenderAll across threads
+struct RenderInfo {
+    Milli_t             currentTime;
+    const LprocList*    procs;
+    Lobj* const*        objs;           // For Lgroup
+    LgroupSoA*          soaGroup;       // For LgroupSoA
+    int                 numObjs;
+    Lframe*             frame;          // The first thread renders directly into this
+    Lframe*             threadFrames;   // The other threads each render into their own
+    int                 numThreads;
+    int                 numChunks;      // For adding the thread frames to frame
+};
+
+// Updates the idx'th block of objects
+void RenderPart(int idx, void* infoArg) {
+    RenderInfo* info = (RenderInfo*) infoArg;
+    int start = (int) ((long long) info->numObjs * idx / info->numThreads);
+    int end   = (int) ((long long) info->numObjs * (idx + 1) / info->numThreads);
+    Lframe* frame = idx == 0 ? info->frame : &info->threadFrames[idx-1];
+    for (int i = start; i < end; ++i)
+        info->objs[i]->Update(info->currentTime, *info->procs, frame);
+}
+
+// Adds the thread frames to the main frame for the idx'th block of pixels
+void ReducePart(int idx, void* infoArg) {
+    RenderInfo* info = (RenderInfo*) infoArg;
+    int count = info->frame->GetCount();
+    int start = (int) ((long long) count * idx / info->numChunks);
+    int end   = (int) ((long long) count * (idx + 1) / info->numChunks);
+    for (int i = 1; i < info->numThreads; ++i)
+        info->frame->AddFrame(info->threadFrames[i-1], start, end);
+}
+
+void Lgroup::RenderAll(Milli_t currentTime, const LprocList& filters, LBuffer* buffer) {
+    iFrame.Load(buffer, iIs2D);
+    int numThreads = GetRenderThreads(GetCount(), filters);
+    if (numThreads <= 1) {
+        for (const_iterator i = begin(); i != end(); ++i)
+            (*i)->Update(currentTime, filters, &iFrame);
+    } else {
+        iThreadFrames.resize(numThreads - 1);
+        for (size_t i = 0; i < iThreadFrames.size(); ++i)
+            iThreadFrames[i].Clear(iFrame.GetWidth(), iFrame.GetHeight());
+
+        RenderInfo info;
+        info.currentTime    = currentTime;
+        info.procs          = &filters;
+        info.objs           = &iObjs[0];
+        info.soaGroup       = NULL;
+        info.numObjs        = iObjs.size();
+        info.frame          = &iFrame;
+        info.threadFrames   = &iThreadFrames[0];
+        info.numThreads     = numThreads;
+        info.numChunks      = numThreads;
+        gRenderPool->ParallelFor(numThreads, RenderPart, &info, true);
+        gRenderPool->ParallelFor(info.numChunks, ReducePart, &info, true);
+    }
+    iFrame.Store(buffer);
 }
 
 /*
@@ -275,3 +389,138 @@ string Lgroup::GetDescription(bool verbose) const {
     }
     return retval;
 }
+
+//----------------------------------------------------------------------
+// LgroupSoA
+//----------------------------------------------------------------------
+
+int LgroupSoA::Add(const Lobj& obj) {
+    int idx = GetCount();
+    Resize(idx + 1);
+    SetObj(idx, obj);
+    return idx;
+}
+
+void LgroupSoA::Resize(int count) {
+    Lobj proto;
+    pos.resize(count, proto.pos);
+    speed.resize(count, proto.speed);
+    width.resize(count, proto.width);
+    color.resize(count, proto.color);
+    renderColor.resize(count, proto.renderColor);
+    lastTime.resize(count, proto.lastTime);
+}
+
+void LgroupSoA::GetObj(int idx, Lobj* obj) const {
+    obj->lastTime       = lastTime[idx];
+    obj->nextTime       = lastTime[idx];
+    obj->speed          = speed[idx];
+    obj->pos            = pos[idx];
+    obj->color          = color[idx];
+    obj->width          = width[idx];
+    obj->renderColor    = renderColor[idx];
+}
+
+void LgroupSoA::SetObj(int idx, const Lobj& obj) {
+    lastTime[idx]       = obj.lastTime;
+    speed[idx]          = obj.speed;
+    pos[idx]            = obj.pos;
+    color[idx]          = obj.color;
+    width[idx]          = obj.width;
+    renderColor[idx]    = obj.renderColor;
+}
+
+// Runs all of the stages for the idx'th block of objects
+void LgroupSoA::RenderPart(int idx, void* infoArg) {
+    RenderInfo* info = (RenderInfo*) infoArg;
+    LgroupSoA* group = info->soaGroup;
+    int start = (int) ((long long) info->numObjs * idx / info->numThreads);
+    int end   = (int) ((long long) info->numObjs * (idx + 1) / info->numThreads);
+    Lframe* frame = idx == 0 ? info->frame : &info->threadFrames[idx-1];
+    group->UpdateMoveAll(info->currentTime, start, end);
+    group->UpdateColorAll(info->currentTime, start, end);
+    group->UpdateProcsAll(info->currentTime, *info->procs, start, end);
+    group->UpdateRenderAll(frame, start, end);
+    group->UpdateDoneAll(info->currentTime, start, end);
+}
+
+void LgroupSoA::RenderAll(Milli_t currentTime, const LprocList& procs, LBuffer* buffer) {
+    int count = GetCount();
+    iFrame.Load(buffer, iIs2D);
+    int numThreads = GetRenderThreads(count, procs);
+    if (numThreads > 1)
+        iThreadFrames.resize(numThreads - 1);
+    for (int i = 0; i < numThreads - 1; ++i)
+        iThreadFrames[i].Clear(iFrame.GetWidth(), iFrame.GetHeight());
+
+    RenderInfo info;
+    info.currentTime    = currentTime;
+    info.procs          = &procs;
+    info.objs           = NULL;
+    info.soaGroup       = this;
+    info.numObjs        = count;
+    info.frame          = &iFrame;
+    info.threadFrames   = iThreadFrames.empty() ? NULL : &iThreadFrames[0];
+    info.numThreads     = numThreads;
+    info.numChunks      = numThreads;
+    if (numThreads <= 1)
+        RenderPart(0, &info);
+    else {
+        gRenderPool->ParallelFor(numThreads, RenderPart, &info, true);
+        gRenderPool->ParallelFor(info.numChunks, ReducePart, &info, true);
+    }
+    iFrame.Store(buffer);
+}
+
+void LgroupSoA::UpdateMoveAll(Milli_t currentTime, int start, int end) {
+    for (int i = start; i < end; ++i) {
+        float timeDiff = MilliDiff(currentTime, lastTime[i]);
+        pos[i] += speed[i] * timeDiff/1000;
+    }
+}
+
+void LgroupSoA::UpdateColorAll(Milli_t currentTime, int start, int end) {
+    for (int i = start; i < end; ++i)
+        renderColor[i] = color[i];
+}
+
+void LgroupSoA::UpdateProcsAll(Milli_t currentTime, const LprocList& procs, int start, int end) {
+    if (start >= end) return;
+    Lobj* obj = NULL;
+    for (size_t p = 0; p < procs.NumProcs(); ++p) {
+        if (! procs.IsObjectProc(p)) continue;
+        if (! obj) obj = AllocObj();
+        for (int i = start; i < end; ++i) {
+            GetObj(i, obj);
+            obj->nextTime = currentTime;
+            procs[p]->Apply(obj);
+            SetObj(i, *obj);
+        }
+    }
+    delete obj;
+}
+
+void LgroupSoA::UpdateDoneAll(Milli_t currentTime, int start, int end) {
+    for (int i = start; i < end; ++i)
+        lastTime[i] = currentTime;
+}
+
+void LgroupSoA::UpdateRenderAll(Lframe* frame, int start, int end) {
+    for (int i = start; i < end; ++i)
+        frame->AddObject(pos[i], width[i], renderColor[i]);
+}
+
+string LgroupSoA::GetDescription(bool verbose) const {
+    string retval;
+    retval += IntToStr(GetCount()) + " objects";
+    if (verbose) {
+        Lobj* obj = AllocObj();
+        for (int i = 0; i < GetCount(); ++i) {
+            GetObj(i, obj);
+            retval += (i == 0 ? ":" : ",");
+            retval += obj->GetDescription(verbose);
+        }
+        delete obj;
+    }
+    return retval;
+}
@@ -6,8 +6,10 @@
 #include "utilsTime.h"
 #include "Color.h"
 #include "LBuffer.h"
+#include "utilsPool.h"
 
 extern bool gAntiAlias; // 1 to enable
+extern int  gRenderThreads; // Set by --renderthreads
 class LprocList; //fwd decl
 
 // Class for holding XY coordinates
@@ -30,12 +32,49 @@ struct Lxy {
     const Lxy operator/(float s)      const {Lxy r = *this; r /= s; return r;}
 };
 
+// A flat frame of pixels that objects are rendered into. Lgroup::RenderAll reads the output into one of these,
+// renders all of its objects and writes it back, so each pixel of an object costs an add rather than a trip down
+// the filter chain. Frames are one row unless loaded as 2D, in which case they have the geometry of the buffer
+// (see LBuffer::GetWidth). Either way, they are stored row by row.
+class Lframe {
+  public:
+    Lframe() : iWidth(0), iHeight(0) {}
+    void        Load(const LBuffer* buffer, bool is2D = false); // Resizes to the buffer and copies it
+    void        Store(LBuffer* buffer) const;
+    void        Clear(int width, int height)        {iWidth = width; iHeight = height; iPixels.assign(width * height, RGBColor());}
+    void        AddFrame(const Lframe& frame, int start, int end); // Adds pixels start through end-1 of frame
+    int         GetCount() const    {return iPixels.size();}
+    int         GetWidth() const    {return iWidth;}
+    int         GetHeight() const   {return iHeight;}
+    RGBColor*   GetPixels()         {return iPixels.empty() ? NULL : &iPixels[0];}
+
+    // Adds to the pixels, ignoring anything out of bounds
+    void        Add(int idx, const RGBColor& rgb)   {if ((unsigned) idx < iPixels.size()) iPixels[idx] += rgb;}
+    void        Add(int x, int y, const RGBColor& rgb) {if ((unsigned) x < (unsigned) iWidth && (unsigned) y < (unsigned) iHeight) iPixels[y * iWidth + x] += rgb;}
+    void        AddSpan(int start, int end, const RGBColor& rgb);   // Pixels start through end-1
+    // Adds an object centered on pos. Objects are width pixels wide (and high, if the frame has more than one row).
+    // Anti-aliased unless width is zero or gAntiAlias is off, in which case the object is snapped to the nearest pixel.
+    void        AddObject(const Lxy& pos, float width, const RGBColor& rgb);
+
+  private:
+    vector<RGBColor> iPixels;
+    int         iWidth;
+    int         iHeight;
+    vector<float> iWeights;     // Used by AddObject2D
+    void        AddObject1D(float x, float width, const RGBColor& rgb);
+    void        AddObject2D(const Lxy& pos, float width, const RGBColor& rgb);
+};
+
+// With --renderthreads, Lgroup::RenderAll updates different objects at the same time. Lobj subclasses must only
+// change the object being updated (and the frame it's given) in their Update functions.
 class Lobj {
   public:
      // Constructor
     Lobj(Milli_t currentTime = Milliseconds()) : /*initColor(BLACK), initWidth(0), */
         lastTime(currentTime), nextTime(currentTime), color(BLACK), width(0) {}
     virtual ~Lobj() {}
+    // Lobjs and derived objects come from block pools so allocating and freeing them each frame doesn't use the heap
+    POOLED_NEW_DELETE
 
     // These variables are set at the beginning
     Lxy         initSpeed;  // Initial speed of the object
@@ -59,10 +98,10 @@ class Lobj {
     virtual void UpdateMove();                          // Moves the object
     virtual void UpdateColor();                         // Updates color and renderColor
     virtual void UpdateProcs(const LprocList& procs);   // Usually just updates renderColor
-    virtual void UpdateRender(LBuffer* output);         // Displays the object using renderColor
+    virtual void UpdateRender(Lframe* frame);           // Displays the object using renderColor
     virtual void UpdateDone() {lastTime = nextTime;}
     // This calls all of the functions above in order
-    virtual void Update(Milli_t currentTime, const LprocList& procs, LBuffer* output);
+    virtual void Update(Milli_t currentTime, const LprocList& procs, Lframe* frame);
 
     // Other operations that can be overloaded
     virtual void Wrap           (const Lxy& minBound, const Lxy& maxBound);
@@ -80,27 +119,74 @@ class Lobj {
     // Info
     virtual string GetTypeName() const {return "Lobj";}
     virtual string GetDescription(bool verbose = false) const;
+
+  private:
+    // Position of the object in its Lgroup so Free is fast. Not copied when the object is copied or assigned.
+    friend class Lgroup;
+    struct GroupIndex {
+        GroupIndex() : idx(-1) {}
+        GroupIndex(const GroupIndex&) : idx(-1) {}
+        GroupIndex& operator=(const GroupIndex&) {return *this;}
+        int idx;
+    };
+    GroupIndex  iGroupIndex;
+};
+
+// What every kind of group has in common: a count, rendering and geometry.
+// Lgroup holds individual Lobjs and LgroupSoA holds arrays, so they don't share ways of getting at the objects.
+class LgroupBase {
+public:
+    LgroupBase() : iIs2D(false) {}
+    virtual ~LgroupBase() {}
+    virtual int GetCount() const = 0;
+
+    // By default, objects are placed by their index in the buffer (pos.x) and pos.y is ignored. 2D groups place
+    // objects at pos.x,pos.y on the buffer's rows (e.g., with the matrix filter).
+    bool    Is2D() const        {return iIs2D;}
+    void    Set2D(bool is2D)    {iIs2D = is2D;}
+
+    // Per-frame procs (e.g., fades) aren't applied here. Apply them to the finished frame with LprocList::ApplyFrameGain.
+    void RenderAll(Milli_t currentTime, LBuffer* buffer);
+    virtual void RenderAll(Milli_t currentTime, const LprocList& procs, LBuffer* buffer) = 0;
+
+    virtual string GetDescription(bool verbose = false) const = 0;
+
+protected:
+    bool            iIs2D;
+    Lframe          iFrame;         // Used by RenderAll
+    vector<Lframe>  iThreadFrames;  // Used by RenderAll for all but the first render thread
+
+    // Returns the number of threads that RenderAll should use for count objects
+    static int  GetRenderThreads(int count, const LprocList& procs);
+
+private:
+    // Don't allow copying
+    LgroupBase(const LgroupBase&);
+    LgroupBase& operator=(const LgroupBase&);
 };
 
-class Lgroup {
+class Lgroup : public LgroupBase {
 public:
-    Lgroup() {}
+    Lgroup() : LgroupBase() {}
     virtual ~Lgroup() {FreeAll();}
     // Access
     Lobj*   Get(int idx) const {if (idx < 0 || (size_t) idx >= iObjs.size()) return NULL; else return iObjs[idx];}
-    int         GetCount() const {return iObjs.size();}
+    virtual int GetCount() const {return iObjs.size();}
 
     // Allocation and deallocation
+    // Both keep the order of the remaining objects by default. Without keepOrder, freed objects are replaced by ones
+    // from the end of the group, which changes the order in which objects are rendered but makes Free constant time
+    // rather than shifting the later objects down. FreeIf takes time proportional to the size of the group either way.
     void Add(Lobj* obj);
     void Add(int num, Lobj::AllocFcn_t fcn, const void* info);
-    bool Free(Lobj* obj);
+    bool Free(Lobj* obj, bool keepOrder = true);
     void FreeAll();
-    void FreeIf(Lobj::FreeIfFcn_t fcn, const void* info);
+    void FreeIf(Lobj::FreeIfFcn_t fcn, const void* info, bool keepOrder = true);
     void FreeIfOutOfBounds(Lxy MinBound, Lxy maxBound) const;
 
     // Common functions
-    void RenderAll(Milli_t currentTime, LBuffer* buffer) const;
-    void RenderAll(Milli_t currentTime, const LprocList& procs, LBuffer* buffer) const;
+    using LgroupBase::RenderAll;
+    virtual void RenderAll(Milli_t currentTime, const LprocList& procs, LBuffer* buffer);
 
 //    void MoveAll    (Milli_t newTime) const;
 //    void WrapAll    (const Lxy& MinBound, const Lxy& maxBound) const;
@@ -121,42 +207,53 @@ public:
 
 private:
     vector<Lobj*> iObjs;
+    int  FindIndex(const Lobj* obj) const;
+    void SetIndex(int idx, Lobj* obj) {iObjs[idx] = obj; obj->iGroupIndex.idx = idx;}
 };
 
-// Obsolete
-class LobjOld {
-  public:
-     // Constructor
-    LobjOld() : pos(0), color(BLACK), speed(0) {}
-    // Variables
-    float    pos;
-    RGBColor maxColor;
-    RGBColor color;
-    float    speed;     // maximum speed
-    float    velocity;  // current velocity
-
-    // Dimming data
-    Milli_t startAttack;
-    Milli_t startHold;
-    Milli_t startRelease;
-    Milli_t startSleep;
-    Milli_t startNext;
-    //enum {kAttack, kSustain, kRelease, kSleep} mode;
-
-    // Standard operations
-    void Render(LBuffer* buffer) const;
-    void Clear();
-
-    // Global operations
-    static short  GetNum(void); // number of Lobjs
-    static short  GetMaxNum(void);  // maximum number of Lobjs
-    static LobjOld*  GetNth(short index);
-    static LobjOld*  Alloc(void);
-    static bool Free(LobjOld*);
-    static void RenderAll(LBuffer* buffer);
-    typedef void (*LobjOldMapFcn_t)(LobjOld*);
-    static void Map(LobjOldMapFcn_t mapfcn);
-};
+// A group that stores its objects as parallel arrays rather than as individual Lobjs. Each stage of the update
+// loop is done for the whole group at once, which is much faster when there are many objects (e.g., one per light).
+// Subclasses may add arrays of their own and override the stages.
+// Per-object procs (e.g., LprocFcn) are applied to a temporary Lobj for each object, which gives the same result
+// but is slower.
+class LgroupSoA : public LgroupBase {
+public:
+    LgroupSoA() : LgroupBase() {}
+    virtual ~LgroupSoA() {}
+    virtual int GetCount() const {return pos.size();}
+
+    // Adds an object initialized from obj and returns its index
+    int             Add(const Lobj& obj);
+    virtual void    Resize(int count);  // New objects are like Lobj()
 
+    // Copies one object to and from an Lobj. Subclasses should copy their own fields.
+    virtual Lobj*   AllocObj() const {return new Lobj();}   // Allocates the Lobj type used by GetObj
+    virtual void    GetObj(int idx, Lobj* obj) const;
+    virtual void    SetObj(int idx, const Lobj& obj);
+
+    using LgroupBase::RenderAll;
+    virtual void RenderAll(Milli_t currentTime, const LprocList& procs, LBuffer* buffer);
+    virtual string GetDescription(bool verbose = false) const;
+
+    // The objects. These all have GetCount() elements. The fields are the same as those of Lobj.
+    vector<Lxy>         pos;
+    vector<Lxy>         speed;
+    vector<float>       width;
+    vector<RGBColor>    color;
+    vector<RGBColor>    renderColor;
+    vector<Milli_t>     lastTime;
+
+protected:
+    // The stages, each done for objects start through end-1. The defaults match the Lobj versions.
+    // With --renderthreads, different ranges are updated at the same time, so a stage must only change its own range.
+    virtual void UpdateMoveAll(Milli_t currentTime, int start, int end);
+    virtual void UpdateColorAll(Milli_t currentTime, int start, int end);
+    virtual void UpdateProcsAll(Milli_t currentTime, const LprocList& procs, int start, int end);
+    virtual void UpdateRenderAll(Lframe* frame, int start, int end);
+    virtual void UpdateDoneAll(Milli_t currentTime, int start, int end);
+
+private:
+    static void RenderPart(int idx, void* info);  // Runs the stages on one thread's range
+};
 
 #endif
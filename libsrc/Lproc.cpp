@@ -3,12 +3,22 @@
 #include "utils.h"
 #include "Lproc.h"
 #include "Lobj.h"
+#include "LBuffer.h"
+
+//---------------------------------------------------------------------------------
+// LprocDim
+//---------------------------------------------------------------------------------
+
+void LprocDim::Apply(Lobj* obj) const {
+    obj->renderColor *= iFraction;
+}
+
 
 //---------------------------------------------------------------------------------
 // LprocFade
 //---------------------------------------------------------------------------------
 
-void LprocFade::Apply(Lobj* obj) const {
+bool LprocFade::GetFraction(float currentTime, float* fraction) const {
     bool isFadeIn;
     bool isExponential;
 
@@ -19,25 +29,32 @@ void LprocFade::Apply(Lobj* obj) const {
         case kExponentialOut:   isFadeIn = false;   isExponential = true; break;
         case kNoFade:
         default:
-            return;
+            return false;
         }
 
-    float currentTime = obj->lastTime;
-    float fraction;
-
     if (isFadeIn) {
-        if (currentTime < iStartTime)       fraction = 0.0;
-        else if (currentTime >= iEndTime)   return; // fraction = 1.0;
-        else fraction = 1.0 * (currentTime - iStartTime) / (iEndTime - iStartTime);
+        if (currentTime < iStartTime)       *fraction = 0.0;
+        else if (currentTime >= iEndTime)   return false; // fraction = 1.0;
+        else *fraction = 1.0 * (currentTime - iStartTime) / (iEndTime - iStartTime);
     } else {
-        if (currentTime < iStartTime)       return; // fraction = 1.0;
-        else if (currentTime >= iEndTime)   fraction = 0.0;
-        else fraction = 1.0 * (iEndTime - currentTime) / (iEndTime - iStartTime);
+        if (currentTime < iStartTime)       return false; // fraction = 1.0;
+        else if (currentTime >= iEndTime)   *fraction = 0.0;
+        else *fraction = 1.0 * (iEndTime - currentTime) / (iEndTime - iStartTime);
     }
 
-    if (isExponential) fraction = fraction * fraction;
+    if (isExponential) *fraction = *fraction * *fraction;
+    return true;
+}
 
-    obj->renderColor = obj->renderColor * fraction;
+void LprocFade::Apply(Lobj* obj) const {
+    float fraction;
+    if (GetFraction(obj->lastTime, &fraction))
+        obj->renderColor = obj->renderColor * fraction;
+}
+
+float LprocFade::GetFrameGain(Milli_t currentTime) const {
+    float fraction;
+    return GetFraction(currentTime, &fraction) ? fraction : 1.0;
 }
 
 //---------------------------------------------------------------------------------
@@ -64,8 +81,32 @@ void LprocList::PrependProc(const Lproc& proc) {
 
 void LprocList::Apply(Lobj* obj) const {
     for (size_t i = 0; i < iProcList.size(); ++i) {
-        iProcList[i]->Apply(obj);
+        if (IsObjectProc(i))
+            iProcList[i]->Apply(obj);
+    }
+}
+
+bool LprocList::IsThreadSafe() const {
+    for (size_t i = 0; i < iProcList.size(); ++i) {
+        if (IsObjectProc(i) && ! iProcList[i]->IsThreadSafe())
+            return false;
     }
+    return true;
+}
+
+float LprocList::GetFrameGain(Milli_t currentTime) const {
+    float gain = 1.0;
+    for (size_t i = 0; i < iProcList.size(); ++i) {
+        if (! IsObjectProc(i))
+            gain *= iProcList[i]->GetFrameGain(currentTime);
+    }
+    return gain;
+}
+
+void LprocList::ApplyFrameGain(Milli_t currentTime, LBuffer* buffer) const {
+    float gain = GetFrameGain(currentTime);
+    if (gain != 1.0)
+        buffer->ScaleRGB(0, buffer->GetCount(), gain);
 }
 
 /* OBSOLETE
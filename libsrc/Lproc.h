@@ -10,6 +10,7 @@
 #include <vector>
 
 class Lobj; // fwd decl
+class LBuffer;
 
 class Lproc {
 public:
@@ -19,18 +20,29 @@ public:
     // These are the key functions that each Lproc must provide
     virtual Lproc* Duplicate() const = 0; // Makes a copy of the Lproc
     virtual void Apply(Lobj* obj) const = 0;
+
+    // Per-frame procs scale every object by the same amount, which depends only on the time.
+    // Instead of being applied to each object, they're applied once to the whole rendered frame using GetFrameGain.
+    virtual bool  IsPerFrame() const                    {return false;}
+    virtual float GetFrameGain(Milli_t currentTime) const {return 1.0;}
+
+    // Return true if Apply may be called for different objects at the same time (see --renderthreads)
+    virtual bool  IsThreadSafe() const                  {return false;}
 };
 
 class LprocFcn : public Lproc {
 public:
     typedef void (*Callback_t) (Lobj* obj);
-    LprocFcn(Callback_t fcn) : iFcn(fcn) {}
+    // Set isThreadSafe if fcn only changes the object it's given
+    LprocFcn(Callback_t fcn, bool isThreadSafe = false) : iFcn(fcn), iIsThreadSafe(isThreadSafe) {}
     virtual ~LprocFcn() {}
     virtual LprocFcn* Duplicate() const {return new LprocFcn(*this);}
     virtual void Apply(Lobj* obj) const {if (iFcn) iFcn(obj);}
+    virtual bool IsThreadSafe() const   {return iIsThreadSafe;}
 
 private:
     Callback_t iFcn;
+    bool       iIsThreadSafe;
 };
 
 class LprocDim : public Lproc {
@@ -40,6 +52,9 @@ public:
 
     virtual Lproc* Duplicate() const {return new LprocDim(*this);}
     virtual void Apply(Lobj* obj) const;
+    virtual bool  IsThreadSafe() const                  {return true;}
+    virtual bool  IsPerFrame() const                    {return true;}
+    virtual float GetFrameGain(Milli_t currentTime) const {return iFraction;}
 private:
     float iFraction;
 };
@@ -52,7 +67,11 @@ public:
 
     virtual Lproc* Duplicate() const {return new LprocFade(*this);}
     virtual void Apply(Lobj* obj) const;
+    virtual bool  IsThreadSafe() const                  {return true;}
+    virtual bool  IsPerFrame() const                    {return true;}
+    virtual float GetFrameGain(Milli_t currentTime) const;
 private:
+    bool    GetFraction(float currentTime, float* fraction) const; // Returns false if the color is unchanged
     Type_t  iType;
     Milli_t iStartTime;
     Milli_t iEndTime;
@@ -83,7 +102,16 @@ public:
     void    PrependProc(const Lproc& proc);
     size_t  NumProcs() const {return iProcList.size();}
     Lproc*  operator[](size_t idx) const {return iProcList[idx];}
+
+    // Applies the procs that aren't per-frame
     void Apply(Lobj* obj) const;
+    bool IsObjectProc(size_t idx) const {return ! iProcList[idx]->IsPerFrame();}
+    bool IsThreadSafe() const;  // True if Apply may be called for different objects at the same time
+
+    // Applies the per-frame procs to a rendered frame. Objects must be rendered additively (the usual case)
+    // for this to match applying the procs to each object.
+    float GetFrameGain(Milli_t currentTime) const;  // Product of the per-frame gains
+    void  ApplyFrameGain(Milli_t currentTime, LBuffer* buffer) const;
 
 //    bool ReplaceProc(int handle, const Lproc& proc);
 //    bool DeleteProc(int handle);
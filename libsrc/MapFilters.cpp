@@ -19,6 +19,100 @@ void MapFilter::InitializeMap() {
     iMap[i] = i;
 }
 
+// Bulk access. If the underlying buffer is contiguous, gather/scatter directly from its memory.
+void MapFilter::ReadRaw(int idx, int count, RGBColor* dest) {
+  const int* map = &iMap[idx];
+  const RGBColor* base = iBuffer->GetRawSpan(0, iBuffer->GetCount());
+  if (base)
+    for (int i = 0; i < count; ++i) dest[i] = base[map[i]];
+  else
+    for (int i = 0; i < count; ++i) dest[i] = iBuffer->GetRawRGB(map[i]);
+}
+
+void MapFilter::WriteRaw(int idx, int count, const RGBColor* src) {
+  const int* map = &iMap[idx];
+  RGBColor* base = iBuffer->GetRawSpan(0, iBuffer->GetCount());
+  if (base)
+    for (int i = 0; i < count; ++i) base[map[i]] = src[i];
+  else
+    for (int i = 0; i < count; ++i) iBuffer->GetRawRGB(map[i]) = src[i];
+}
+
+void MapFilter::FillRaw(int idx, int count, const RGBColor& rgb) {
+  const int* map = &iMap[idx];
+  RGBColor* base = iBuffer->GetRawSpan(0, iBuffer->GetCount());
+  if (base)
+    for (int i = 0; i < count; ++i) base[map[i]] = rgb;
+  else
+    for (int i = 0; i < count; ++i) iBuffer->GetRawRGB(map[i]) = rgb;
+}
+
+//-----------------------------------------------------------------------------
+// MatrixFilter -- Maps row-major coordinates to the wiring of an LED matrix
+//-----------------------------------------------------------------------------
+
+MatrixFilter::Layout_t MatrixFilter::StrToLayout(csref str) {
+  if      (StrEQ(str, "rows"))                                      return kRows;
+  else if (StrEQ(str, "zigzag") || StrEQ(str, "serpentine"))        return kZigzag;
+  else if (StrEQ(str, "columns"))                                   return kColumns;
+  else if (StrEQ(str, "colzigzag") || StrEQ(str, "colserpentine"))  return kColumnZigzag;
+  else return kError;
+}
+
+string MatrixFilter::LayoutToStr(Layout_t layout) {
+  switch (layout) {
+    case kRows:         return "rows";
+    case kZigzag:       return "zigzag";
+    case kColumns:      return "columns";
+    case kColumnZigzag: return "colzigzag";
+    default:            return "error";
+  }
+}
+
+string MatrixFilter::GetDescriptor() const {
+  return "matrix(" + IntToStr(iWidth) + "," + IntToStr(iHeight) + "," + LayoutToStr(iLayout) + ")";
+}
+
+void MatrixFilter::InitializeMap() {
+  int count = iBuffer->GetCount();
+  bool byColumn = iLayout == kColumns || iLayout == kColumnZigzag;
+  iNumColumns = byColumn ? min(iWidth, count / iHeight) : iWidth;
+  iNumRows    = byColumn ? iHeight : min(iHeight, count / iWidth);
+  iMap.resize(iNumColumns * iNumRows);
+  for (int y = 0; y < iNumRows; ++y) {
+    for (int x = 0; x < iNumColumns; ++x) {
+      int idx;
+      switch (iLayout) {
+        case kZigzag:       idx = y * iWidth  + (y % 2 == 0 ? x : iWidth  - 1 - x); break;
+        case kColumns:      idx = x * iHeight + y; break;
+        case kColumnZigzag: idx = x * iHeight + (x % 2 == 0 ? y : iHeight - 1 - y); break;
+        case kRows:
+        default:            idx = y * iWidth  + x; break;
+      }
+      iMap[y * iNumColumns + x] = idx;
+    }
+  }
+}
+
+LFilter* MatrixFilterCreate(cvsref params, string* errmsg) {
+    if (! ParamListCheck(params, "matrix", errmsg, 2, 3)) return NULL;
+    int width, height;
+    string layoutStr = "rows";
+    if (! ParseRequiredParam(&width,  params, 0, "matrix width",  errmsg, 1)) return NULL;
+    if (! ParseRequiredParam(&height, params, 1, "matrix height", errmsg, 1)) return NULL;
+    if (! ParseOptionalParam(&layoutStr, params, 2, "matrix layout", errmsg)) return NULL;
+    MatrixFilter::Layout_t layout = MatrixFilter::StrToLayout(layoutStr);
+    if (layout == MatrixFilter::kError) {
+        if (errmsg) *errmsg = "Unknown matrix layout: " + layoutStr;
+        return NULL;
+    }
+    return new MatrixFilter(width, height, layout);
+}
+
+DEFINE_LBUFFER_FILTER_TYPE(matrix, MatrixFilterCreate, "matrix(width,height[,layout])",
+        "Treats the device as a width by height LED matrix. Layout is how the matrix is wired: rows (default),\n"
+        "  zigzag (rows alternating direction), columns, or colzigzag. Example: matrix(64,64,zigzag)");
+
 //-----------------------------------------------------------------------------
 // ShiftFilter -- Rotates the output a fixed amount
 //-----------------------------------------------------------------------------
@@ -126,6 +220,25 @@ LFilter* ReverseBufferCreate(cvsref params, string* errmsg)
     return new ReverseBuffer();
 }
 
+// The reversed range is contiguous in iBuffer, so just copy it backwards
+void ReverseBuffer::ReadRaw(int idx, int count, RGBColor* dest) {
+  int start = iBuffer->GetCount() - idx - count;
+  const RGBColor* span = iBuffer->GetRawSpan(start, count);
+  if (span)
+    reverse_copy(span, span + count, dest);
+  else
+    for (int i = 0; i < count; ++i) dest[count - i - 1] = iBuffer->GetRawRGB(start + i);
+}
+
+void ReverseBuffer::WriteRaw(int idx, int count, const RGBColor* src) {
+  int start = iBuffer->GetCount() - idx - count;
+  RGBColor* span = iBuffer->GetRawSpan(start, count);
+  if (span)
+    reverse_copy(src, src + count, span);
+  else
+    for (int i = 0; i < count; ++i) iBuffer->GetRawRGB(start + i) = src[count - i - 1];
+}
+
 DEFINE_LBUFFER_FILTER_TYPE(flip, ReverseBufferCreate, "flip",
         "Reverses the order of pixels");
 
@@ -24,27 +24,67 @@ public:
 
 protected:
     virtual RGBColor&   GetRawRGB(int idx) {return iBuffer->GetRawRGB(iMap[idx]);}
+    // Bulk access gathers/scatters through the map
+    virtual RGBColor*   GetRawSpan(int idx, int count) {return NULL;}
+    virtual void        ReadRaw (int idx, int count, RGBColor* dest);
+    virtual void        WriteRaw(int idx, int count, const RGBColor* src);
+    virtual void        FillRaw (int idx, int count, const RGBColor& rgb);
     vector<int> iMap;
 private:
     void AllocateMap() {if (iBuffer) iMap.resize(iBuffer->GetCount());}
 };
 
+//-----------------------------------------------------------------------------
+// MatrixFilter
+//-----------------------------------------------------------------------------
+// Treats the buffer as an LED matrix. The filter's pixels are in row-major order (see LBuffer::GetWidth) and are
+// mapped to the order the matrix is wired in.
+// Objects are only drawn in 2D by groups that are set to 2D (see Lgroup::Set2D). Other groups fill the rows in order.
+class MatrixFilter : public MapFilter
+{
+public:
+    typedef enum {kRows = 0, kZigzag = 1, kColumns = 2, kColumnZigzag = 3, kError = -1} Layout_t;
+    static Layout_t StrToLayout(csref str);
+    static string   LayoutToStr(Layout_t layout);
+
+    MatrixFilter(int width, int height, Layout_t layout = kRows)
+        : MapFilter(), iWidth(width), iHeight(height), iLayout(layout), iNumColumns(0), iNumRows(0) {}
+    virtual ~MatrixFilter() {}
+    virtual int     GetWidth() const    {return iNumColumns;}
+    virtual int     GetHeight() const   {return iNumRows;}
+    virtual string  GetDescriptor() const;
+    // If the buffer is too small, the rows (or columns for the column layouts) that don't fit are dropped
+    virtual void    InitializeMap();
+
+private:
+    int         iWidth;
+    int         iHeight;
+    Layout_t    iLayout;
+    int         iNumColumns;    // Actual size
+    int         iNumRows;
+};
+
 //-----------------------------------------------------------------------------
 // Static Shift/Rotate
 //-----------------------------------------------------------------------------
 
+namespace L {class Pipeline;}
+
 class ShiftFilter : public MapFilter
 {
 public:
-    ShiftFilter(int offset = 0) : iOffset(offset), MapFilter() {} // Note that it's important to set iOffset first, so it will be set for the call to InitializeMap
+    ShiftFilter(int offset = 0) : iOffset(offset), MapFilter(), iIsRouted(false) {} // Note that it's important to set iOffset first, so it will be set for the call to InitializeMap
     virtual ~ShiftFilter() {}
     virtual string GetDescriptor() const;
-    void SetOffset(int offset) {iOffset = offset; InitializeMap();}
+    // The output pipeline applies the offset itself when it can (see Pipeline::CompileRoutes), so its routes stay valid
+    void SetOffset(int offset) {if (offset == iOffset) return; iOffset = offset; InitializeMap(); if (! iIsRouted) MapChanged();}
     int GetOffset() const {return iOffset;}
     virtual void InitializeMap();
 
 private:
-    int iOffset;
+    friend class L::Pipeline;
+    int  iOffset;
+    bool iIsRouted;     // Set while the output pipeline is applying iOffset
 };
 
 //-----------------------------------------------------------------------------
@@ -103,6 +143,10 @@ public:
 
 protected:
   virtual RGBColor&   GetRawRGB(int idx) {idx = iBuffer->GetCount() - idx - 1; return iBuffer->GetRawRGB(idx);}
+  virtual RGBColor*   GetRawSpan(int idx, int count) {return NULL;}
+  virtual void        ReadRaw (int idx, int count, RGBColor* dest);
+  virtual void        WriteRaw(int idx, int count, const RGBColor* src);
+  virtual void        FillRaw (int idx, int count, const RGBColor& rgb) {iBuffer->FillRaw(iBuffer->GetCount() - idx - count, count, rgb);}
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,208 @@
+// Transmits frames to the output devices on a separate thread
+//
+
+#include "OutputThread.h"
+#include "LBuffer.h"
+#include "utilsThread.h"
+#include "utilsOptions.h"
+#include <algorithm>
+
+namespace OutputThread {
+
+//---------------------------------------------------------------
+// Options
+//---------------------------------------------------------------
+int         gNumThreads     = 1;
+bool        gOrdered        = false;
+ThreadPool* gPool           = NULL;
+
+string ThreadsDefaultCallback(csref name) {
+    return IntToStr(gNumThreads);
+    }
+
+string ThreadsCallback(csref name, csref val) {
+    if (StrEQ(val, "auto")) {
+        gNumThreads = NumberOfProcessors();
+        return "";
+    }
+    if (! StrToInt(val, &gNumThreads))
+        return "The --" + name + " parameter, " + val + ", was not an integer or 'auto'.";
+    if (gNumThreads < 1)
+        return "--" + name + " must be at least 1.";
+    return "";
+}
+
+DefOption(outputthreads, ThreadsCallback, "numthreads", "sets the number of threads used to update multiple devices. 'auto' uses one per processor.", ThreadsDefaultCallback);
+
+string OrderedCallback(csref name, csref val) {
+    gOrdered = true;
+    return "";
+    }
+DefOptionBool(outputorder, OrderedCallback, "with --outputthreads, always updates each device from the same thread in a fixed order");
+
+int GetNumThreads() {
+    return gNumThreads;
+}
+
+void ParallelFor(int count, void (*fcn)(int idx, void* info), void* info) {
+    if (gNumThreads > 1 && ! gPool) gPool = new ThreadPool(gNumThreads);
+    if (gPool)
+        gPool->ParallelFor(count, fcn, info, gOrdered);
+    else
+        for (int i = 0; i < count; ++i) fcn(i, info);
+}
+
+//---------------------------------------------------------------
+// Frame hooks
+//---------------------------------------------------------------
+vector<FrameHook_t> gFrameEndHooks;
+volatile bool       gIsTransmitting = false;
+
+void AddFrameEndHook(FrameHook_t hook) {
+    if (find(gFrameEndHooks.begin(), gFrameEndHooks.end(), hook) == gFrameEndHooks.end())
+        gFrameEndHooks.push_back(hook);
+}
+
+void BeginTransmit() {
+    gIsTransmitting = true;
+}
+
+void EndTransmit() {
+    gIsTransmitting = false;
+    for (size_t i = 0; i < gFrameEndHooks.size(); ++i)
+        gFrameEndHooks[i]();
+}
+
+bool IsTransmitting() {
+    return gIsTransmitting;
+}
+
+//---------------------------------------------------------------
+// Output thread
+//---------------------------------------------------------------
+
+class Sender : public Thread
+{
+public:
+    Sender() : iHasFrame(false), iStopRequested(false), iSuccess(true), iFrameOpen(false) {}
+    virtual ~Sender() {Stop();}
+
+    void Stop();
+    bool BeginFrame();
+    void EndFrame();
+    void Queue(LBufferPhys* buffer) {iQueued.push_back(buffer);}
+    bool IsFrameOpen() const        {return iFrameOpen;}
+
+protected:
+    virtual void Run();
+
+private:
+    Mutex                   iMutex;
+    Condition               iCondition;
+    // The render thread only touches iQueued and the output thread only touches iSending while iHasFrame is set
+    vector<LBufferPhys*>    iQueued;
+    vector<LBufferPhys*>    iSending;
+    vector<char>            iResults;           // Result of transmitting each of iSending
+    bool                    iHasFrame;          // iSending holds a frame that hasn't been sent yet
+    bool                    iStopRequested;
+    bool                    iSuccess;           // Result of the last frame
+    bool                    iFrameOpen;         // Only used by the render thread
+    static void TransmitOne(int idx, void* info);
+    void WaitForFrameSent();                    // iMutex must be locked
+};
+
+void Sender::Run() {
+    iMutex.Lock();
+    while (true) {
+        while (! iHasFrame && ! iStopRequested)
+            iCondition.Wait(iMutex);
+        if (! iHasFrame) break;
+        iMutex.Unlock();
+
+        iResults.resize(iSending.size());
+        BeginTransmit();
+        ParallelFor(iSending.size(), TransmitOne, this);
+        EndTransmit();
+        bool success = true;
+        for (size_t i = 0; i < iResults.size(); ++i)
+            success = iResults[i] && success;
+
+        iMutex.Lock();
+        iSuccess = success;
+        iHasFrame = false;
+        iCondition.Broadcast();
+    }
+    iMutex.Unlock();
+}
+
+void Sender::TransmitOne(int idx, void* info) {
+    Sender* sender = (Sender*) info;
+    sender->iResults[idx] = sender->iSending[idx]->TransmitFront();
+}
+
+void Sender::WaitForFrameSent() {
+    while (iHasFrame)
+        iCondition.Wait(iMutex);
+}
+
+bool Sender::BeginFrame() {
+    MutexLock lock(iMutex);
+    WaitForFrameSent();
+    iQueued.clear();
+    iFrameOpen = true;
+    return iSuccess;
+}
+
+void Sender::EndFrame() {
+    if (! iFrameOpen) return;
+    iFrameOpen = false;
+    if (iQueued.empty()) return;
+    MutexLock lock(iMutex);
+    iSending.swap(iQueued);
+    iHasFrame = true;
+    iCondition.Broadcast();
+}
+
+void Sender::Stop() {
+    if (! IsRunning()) return;
+    iMutex.Lock();
+    WaitForFrameSent();
+    iStopRequested = true;
+    iCondition.Broadcast();
+    iMutex.Unlock();
+    Join();
+    iStopRequested = false;
+}
+
+Sender* gSender = NULL;
+
+bool Start() {
+    if (! gSender) gSender = new Sender();
+    return gSender->Start();
+}
+
+void Stop() {
+    if (gSender) gSender->Stop();
+}
+
+bool IsRunning() {
+    return gSender && gSender->IsRunning();
+}
+
+bool BeginFrame() {
+    return IsRunning() ? gSender->BeginFrame() : true;
+}
+
+void EndFrame() {
+    if (gSender) gSender->EndFrame();
+}
+
+bool IsFrameOpen() {
+    return gSender && gSender->IsFrameOpen();
+}
+
+void Queue(LBufferPhys* buffer) {
+    gSender->Queue(buffer);
+}
+
+}; // namespace OutputThread
@@ -0,0 +1,46 @@
+// Transmits frames to the output devices on a separate thread
+//
+// While the output thread is running, LBufferPhys::Update copies the buffer into a front buffer and queues it
+// instead of sending it. The queued buffers are handed to the thread at the end of the frame so the next frame
+// can be rendered while this one is sent. The render thread only waits if the previous frame is still being
+// sent, so output is never more than one frame behind.
+
+#ifndef OUTPUTTHREAD_H_INCLUDED
+#define OUTPUTTHREAD_H_INCLUDED
+
+#include "utils.h"
+#include <vector>
+
+class LBufferPhys;
+
+namespace OutputThread {
+bool    Start();        // Returns false if the thread couldn't be created
+void    Stop();         // Sends the last frame and stops the thread
+bool    IsRunning();
+
+// These bracket the updates for one frame. BeginFrame waits for the previous frame to finish sending and
+// returns false if any of its devices failed. Frames are only queued while the thread is running.
+bool    BeginFrame();
+void    EndFrame();
+bool    IsFrameOpen();
+
+// Called by LBufferPhys::Update while a frame is open
+void    Queue(LBufferPhys* buffer);
+
+// Brackets the transmission of a frame to all of the devices, either by L::Pipeline::Update or by the output thread.
+// While a frame is being transmitted, devices may hold their data and send it from a frame end hook, which is
+// called by EndTransmit after every device has been updated (e.g., to send all of the UDP packets at once).
+typedef void (*FrameHook_t)();
+void    AddFrameEndHook(FrameHook_t hook);
+void    BeginTransmit();
+void    EndTransmit();
+bool    IsTransmitting();
+
+// Devices are updated on this many threads (--outputthreads). 1 means they're updated one after another.
+int     GetNumThreads();
+// Runs fcn(i, info) for i from 0 to count-1 across the output threads and waits for them to finish.
+// With --outputorder, each thread always handles the same block of devices, in order.
+void    ParallelFor(int count, void (*fcn)(int idx, void* info), void* info);
+}; // namespace OutputThread
+
+#endif // !OUTPUTTHREAD_H_INCLUDED
@@ -57,6 +57,7 @@ void ForceLinkStrip() {}
 #include "Color.h"
 #include "utilsGPIO.h"
 #include "utilsParse.h"
+#include "ColorQuantize.h"
 
 //-----------------------------------------------------------------------------
 // Creation function
@@ -139,22 +140,12 @@ DEFINE_LBUFFER_DEVICE_TYPE(strip, StripBufferCreate, "strip:stripInfo(size)",
 // WS2801 Specific Support
 //-----------------------------------------------------------------------------
 
-int PackRGB(const RGBColor& color, bool flip) {
-    int r = min(255, max(0, (int) (color.r * 256)));
-    int g = min(255, max(0, (int) (color.g * 256)));
-    int b = min(255, max(0, (int) (color.b * 256)));
-
-    if (flip)
-        return r * 0x10000 + g * 0x100 + b;
-    else
-        return r + g * 0x100 + b * 0x10000;
-}
-
 Micro_t kMinTimeBetweenUpdates = 500; // In Microseconds. This is a requirement of the WS2801 chip
 
-bool StripBufferWS2801::Update() {
-    const_iterator bufBegin = const_cast<const StripBufferWS2801*>(this)->begin();
-    const_iterator bufEnd   = const_cast<const StripBufferWS2801*>(this)->end();
+bool StripBufferWS2801::Transmit(const RGBColor* colors, int count) {
+    // Convert the whole frame first. Newer strips want blue first; the flipped (older) ones want red first.
+    iBytes.resize(count * 3);
+    if (count > 0) QuantizeRGB(colors, count, &iBytes[0], GetColorFlip() ? kChannelOrderRGB : kChannelOrderBGR);
 
     // Check if we need to sleep
     Micro_t timeSinceLast = MicroDiff(Microseconds(), iLastTime);
@@ -162,13 +153,13 @@ bool StripBufferWS2801::Update() {
       // Need to wait more time
       SleepMicro(kMinTimeBetweenUpdates - timeSinceLast);
 
-    for (const_iterator i = bufBegin; i != bufEnd; ++i) {
-        int colorword = PackRGB(*i, GetColorFlip());
-        for (int j = 23; j >= 0; --j) {
+    for (size_t i = 0; i < iBytes.size(); ++i) {
+        int colorbyte = iBytes[i];
+        for (int j = 7; j >= 0; --j) {
             // Serialize this color. Clock in the data
             int mask = 1 << j;
             GPIO::Write(iCLKgpio, false);
-            GPIO::Write(iSDIgpio, colorword & mask);
+            GPIO::Write(iSDIgpio, colorbyte & mask);
             GPIO::Write(iCLKgpio, true);
         }
     }
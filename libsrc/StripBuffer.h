@@ -19,11 +19,13 @@ public:
     virtual ~StripBuffer() {}
 
     virtual string  GetDescriptor() const {return (iCreateString.empty() ? "unknownstriptype" : iCreateString); }
-    virtual bool    Update() {iLastError = "Attempted to update invalid strip."; return false;}
     void            SetCreateString(csref str)  {iCreateString = str;}
     void            SetColorFlip(bool val)      {iColorFlip = val;}
     bool            GetColorFlip() const        {return iColorFlip;}
 
+protected:
+    virtual bool    Transmit(const RGBColor* colors, int count) {iLastError = "Attempted to update invalid strip."; return false;}
+
 private:
     string              iCreateString;
     bool                iColorFlip;
@@ -38,11 +40,14 @@ public:
     StripBufferWS2801(int count, int SDIgpio, int CLKgpio) : StripBuffer(count), iSDIgpio(SDIgpio), iCLKgpio(CLKgpio), iLastTime(Microseconds()) {}
     virtual ~StripBufferWS2801() {}
 
-    virtual bool    Update();
+protected:
+    virtual bool    Transmit(const RGBColor* colors, int count);
+
 private:
     int iSDIgpio;
     int iCLKgpio;
     Micro_t iLastTime;
+    vector<unsigned char> iBytes; // The frame in the order it is sent
     // Don't allow copying
     StripBufferWS2801(const StripBufferWS2801&);
     StripBufferWS2801& operator=(const StripBufferWS2801&);
@@ -5,6 +5,7 @@
 #include "WinBuffer.h"
 #include "LFramework.h"
 #include "utilsParse.h"
+#include "ColorQuantize.h"
 
 // Dummy function to force this file to be linked in.
 void ForceLinkWin() {}
@@ -56,7 +57,7 @@ DEFINE_LBUFFER_DEVICE_TYPE(window, WinBufferCreate, "window(count,flags)",
 // Update function
 //-----------------------------------------------------------------------------
 
-bool    WinBuffer::Update() {
+bool    WinBuffer::Transmit(const RGBColor* colors, int count) {
     if (! iWindow.isOpen() || L::gTerminateNow) {
         iLastError = "Window is Closed";
         L::gTerminateNow = true;
@@ -105,11 +106,11 @@ bool    WinBuffer::Update() {
     iWindow.clear(sf::Color(60,60,60));
     // Create the shape
     sf::CircleShape shape(diameter * .5);
-    RGBColor rgb;
+    vector<unsigned char> bytes(count * 3);
+    if (count > 0) QuantizeRGB(colors, count, &bytes[0]);
 
-    for (LBuffer::iterator i = begin(); i < end(); ++i) {
-        i->ToRGBColor(&rgb);
-        sf::Color color(rgb.rAsChar(), rgb.gAsChar(), rgb.bAsChar());
+    for (int i = 0; i < count; ++i) {
+        sf::Color color(bytes[i*3], bytes[i*3+1], bytes[i*3+2]);
         shape.setFillColor(color);
         shape.setPosition(x,y);
         if (IsVertical()) 
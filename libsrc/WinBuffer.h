@@ -28,10 +28,13 @@ public:
     void        SetTitle(csref title) {iWindow.setTitle(title);}
 
     virtual string  GetDescriptor() const;
-    virtual bool    Update();
+    virtual bool    CanUpdateAsync() const  {return false;}  // SFML events must be handled on the main thread
     void            SetCreateString(csref str)  {iCreateString = str;}
     bool            IsVertical() const {return iWinInfo.isVertical;}
 
+protected:
+    virtual bool    Transmit(const RGBColor* colors, int count);
+
 private:
     string              iCreateString;
     WinInfo             iWinInfo;  // Initial setup
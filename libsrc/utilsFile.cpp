@@ -1,9 +1,17 @@
 #include "utilsFile.h"
 #include <fstream>
+#include <stdio.h>
+
+void File::Init(csref name, int mode)
+{
+    iName = name;
+    iMode = mode;
+    iLastError.clear();
+}
 
 ios_base::openmode File::GetOpenMode(bool isWriteMode)
 {
-    ios_base::openmode mode;
+    ios_base::openmode mode = ios_base::openmode();
     if (isWriteMode)
         mode |= ios_base::out;
     else
@@ -34,5 +42,35 @@ bool File::ReadToString(string* str)
     buffer[length] = '\0';
     fstr.close();
     str->assign(buffer, length);
+    delete[] buffer;
+    return true;
+}
+
+bool File::WriteFromString(csref str)
+{
+    string tmpName = iName + ".tmp";
+    ofstream fstr(tmpName.c_str(), GetOpenMode(true));
+    if (fstr.fail())
+    {
+        iLastError = "Error opening " + tmpName;
+        return false;
+    }
+    fstr.write(str.data(), str.size());
+    fstr.close();
+    if (fstr.fail())
+    {
+        iLastError = "Error writing " + tmpName;
+        remove(tmpName.c_str());
+        return false;
+    }
+#ifdef OS_WINDOWS
+    remove(iName.c_str()); // rename doesn't replace existing files on Windows
+#endif
+    if (rename(tmpName.c_str(), iName.c_str()) != 0)
+    {
+        iLastError = "Error renaming " + tmpName + " to " + iName + ": " + ErrorCodeString();
+        remove(tmpName.c_str());
+        return false;
+    }
     return true;
 }
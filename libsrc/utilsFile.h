@@ -12,6 +12,8 @@ public:
     File(csref name, int mode = 0) {Init(name, mode);}
     void Init(csref name, int mode = 0);
     bool ReadToString(string* str);
+    // Replaces the file's contents. Writes a temporary file and renames it so readers never see a partial file.
+    bool WriteFromString(csref str);
     // Accessors
     string  GetName     () const {return iName;}
     bool    HasError    () const {return !iLastError.empty();}
@@ -6,6 +6,7 @@
 #if defined(HAS_GPIO) && HAS_GPIO
 #include <iostream>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/mman.h>
 
 namespace GPIO {
@@ -254,7 +254,7 @@ string RemoveDir(csref str) {
 void Option::ParseArglist(int *argc, char** argv, int minPositionalArgs, int maxPositionalArgs) {
     if (maxPositionalArgs < 0) maxPositionalArgs = minPositionalArgs;
 
-    if (argc > 0 && argv != NULL && argv[0] != NULL) {
+    if (argc && *argc > 0 && argv != NULL && argv[0] != NULL) {
         ProgramHelp(kPHprogram, RemoveDir(argv[0]));
         ++argv;
     }
@@ -180,7 +180,7 @@ template<>
     char endChar = paramString[0];
 
     if (endChar != '"' && endChar != '\'') {
-        *out = paramString[0];
+        *out = paramString;
         return true;
     }
     // Handle quoted string
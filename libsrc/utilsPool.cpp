@@ -0,0 +1,89 @@
+// Fixed-size block pools
+//
+
+#include "utilsPool.h"
+#include <new>
+
+volatile int BlockPool::gNumHeapAllocs = 0;
+volatile int BlockPool::gNumPoolAllocs = 0;
+
+BlockPool::BlockPool(size_t blockSize, int blocksPerChunk) : iBlockSize(blockSize), iBlocksPerChunk(blocksPerChunk), iFreeList(NULL)
+{
+    // Every block must be able to hold the free list link and stay aligned
+    const size_t align = sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*);
+    if (iBlockSize < sizeof(FreeBlock)) iBlockSize = sizeof(FreeBlock);
+    iBlockSize = (iBlockSize + align - 1) / align * align;
+    if (iBlocksPerChunk < 1) iBlocksPerChunk = 1;
+}
+
+BlockPool::~BlockPool()
+{
+    for (size_t i = 0; i < iChunks.size(); ++i)
+        ::operator delete(iChunks[i]);
+}
+
+void* BlockPool::Alloc()
+{
+    MutexLock lock(iMutex);
+    if (! iFreeList) {
+        // Out of blocks. Get another chunk and thread it onto the free list.
+        char* chunk = (char*) ::operator new(iBlockSize * iBlocksPerChunk);
+        AtomicAdd(&gNumHeapAllocs, 1);
+        iChunks.push_back(chunk);
+        for (int i = iBlocksPerChunk - 1; i >= 0; --i) {
+            FreeBlock* block = (FreeBlock*) (chunk + i * iBlockSize);
+            block->next = iFreeList;
+            iFreeList = block;
+        }
+    }
+    FreeBlock* block = iFreeList;
+    iFreeList = block->next;
+    AtomicAdd(&gNumPoolAllocs, 1);
+    return block;
+}
+
+void BlockPool::Free(void* ptr)
+{
+    if (! ptr) return;
+    MutexLock lock(iMutex);
+    FreeBlock* block = (FreeBlock*) ptr;
+    block->next = iFreeList;
+    iFreeList = block;
+}
+
+//-----------------------------------------------------------------------------
+// Size classes
+//-----------------------------------------------------------------------------
+// Blocks are grouped in multiples of kSizeQuantum. Anything bigger than the largest class comes from the heap.
+const size_t kSizeQuantum   = 16;
+const int    kNumSizeClasses = 16;
+
+struct SizePools {
+    SizePools() {for (int i = 0; i < kNumSizeClasses; ++i) pools[i] = new BlockPool((i + 1) * kSizeQuantum);}
+    BlockPool* pools[kNumSizeClasses];
+};
+
+// Created on first use so pooled objects can be allocated by static constructors. Never deleted since pooled
+// objects may be freed by static destructors.
+BlockPool* GetSizePool(size_t size)
+{
+    static SizePools* sizePools = new SizePools();
+    size_t idx = size == 0 ? 0 : (size - 1) / kSizeQuantum;
+    if (idx >= (size_t) kNumSizeClasses) return NULL;
+    return sizePools->pools[idx];
+}
+
+void* BlockPool::AllocSized(size_t size)
+{
+    BlockPool* pool = GetSizePool(size);
+    if (pool) return pool->Alloc();
+    AtomicAdd(&gNumHeapAllocs, 1);
+    return ::operator new(size);
+}
+
+void BlockPool::FreeSized(void* block, size_t size)
+{
+    BlockPool* pool = GetSizePool(size);
+    if (pool) pool->Free(block);
+    else ::operator delete(block);
+}
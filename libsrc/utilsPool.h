@@ -0,0 +1,56 @@
+// Fixed-size block pools for objects that are allocated and freed every frame
+//
+
+#ifndef UTILSPOOL_H_INCLUDED
+#define UTILSPOOL_H_INCLUDED
+
+#include "utils.h"
+#include "utilsThread.h"
+#include <vector>
+#include <stddef.h>
+
+// Hands out blocks of one size. Freed blocks go on a free list and are reused, so once the pool has grown
+// to the peak number of live blocks it never touches the heap again. Memory is only returned when the pool
+// is destroyed. Thread safe.
+class BlockPool
+{
+public:
+    BlockPool(size_t blockSize, int blocksPerChunk = 64);
+    ~BlockPool();
+
+    void*   Alloc();
+    void    Free(void* block);
+    size_t  GetBlockSize() const {return iBlockSize;}
+
+    // Statistics summed over all pools
+    static int  GetNumHeapAllocs()  {return gNumHeapAllocs;}   // Times the heap was used (chunks or oversized blocks)
+    static int  GetNumPoolAllocs()  {return gNumPoolAllocs;}   // Blocks handed out
+
+    // Used by classes that pool their instances (see POOLED_NEW_DELETE)
+    // Returns a block of at least size bytes from the pool for that size or from the heap if it's too large
+    static void* AllocSized(size_t size);
+    static void  FreeSized(void* block, size_t size);
+
+private:
+    struct FreeBlock {FreeBlock* next;};
+    size_t              iBlockSize;
+    int                 iBlocksPerChunk;
+    FreeBlock*          iFreeList;
+    vector<char*>       iChunks;
+    Mutex               iMutex;
+
+    static volatile int gNumHeapAllocs;
+    static volatile int gNumPoolAllocs;
+
+    // Don't allow copying
+    BlockPool(const BlockPool&);
+    BlockPool& operator=(const BlockPool&);
+};
+
+// Put this in a class declaration to allocate it and all of its subclasses from the block pools.
+// The class must have a virtual destructor so delete gets the size of the actual object.
+#define POOLED_NEW_DELETE \
+    static void* operator new(size_t size)              {return BlockPool::AllocSized(size);} \
+    static void  operator delete(void* p, size_t size)  {BlockPool::FreeSized(p, size);}
+
+#endif // UTILSPOOL_H_INCLUDED
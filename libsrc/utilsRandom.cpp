@@ -4,6 +4,7 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <algorithm> // for min/max
+#include <time.h>  // for time and clock
 
 //------------------------------------------------
 // Random Utilities
@@ -4,6 +4,7 @@
 
 #include "utilsSocket.h"
 #include <string.h>
+#include <algorithm>
 
 //----------------------------------------------------------------------------
 // Platform specific
@@ -232,6 +233,32 @@ bool SocketIP::HasData(int timeoutInMS) {
     }
 }
 
+int SocketIP::WaitForData(SocketIP* const* sockets, int count, bool* hasData, int timeoutInMS) {
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    SOCKET maxSocket = 0;
+    for (int i = 0; i < count; ++i) {
+        hasData[i] = false;
+        if (! sockets[i]->iIsOpen) continue;
+        FD_SET(sockets[i]->iSocket, &fdset);
+        maxSocket = max(maxSocket, sockets[i]->iSocket);
+    }
+    struct timeval tv;
+    struct timeval* tvarg = &tv;
+    if (timeoutInMS == kInfinite)
+        tvarg = NULL;
+    else {
+        tv.tv_sec = timeoutInMS / 1000;
+        tv.tv_usec = (timeoutInMS % 1000) * 1000;
+    }
+
+    int status = select(maxSocket+1, &fdset, NULL, NULL, tvarg);
+    if (status == SOCKET_ERROR) return -1;
+    for (int i = 0; i < count; ++i)
+        if (sockets[i]->iIsOpen && FD_ISSET(sockets[i]->iSocket, &fdset)) hasData[i] = true;
+    return status;
+}
+
 bool SocketIP::Discard()
 {
   char buffer[1000];
@@ -349,6 +376,78 @@ bool SocketIP::MultiWrite(const Buffer* buffers, int count)
 	return true;
 	}
 
+// Used when there's no sendmmsg or it fails
+static bool SendOneDatagram(SOCKET sock, SocketIP::Datagram* dg, string* errmsg)
+	{
+	long bytesWritten = sendto(sock, (const char*) dg->ptr, dg->len, 0, dg->addr->GetStruct(), dg->addr->GetStructSize());
+	dg->sent = (bytesWritten == dg->len);
+	if (! dg->sent)
+		*errmsg = "Socket error trying to write " + IntToStr(dg->len) + " bytes to " + dg->addr->GetString() + ": "
+			+ (bytesWritten < 0 ? SocketErrorString() : "Partial write of " + IntToStr(bytesWritten) + " bytes");
+	return dg->sent;
+	}
+
+#ifdef OS_LINUX
+// Number of datagrams handed to each sendmmsg call
+const int kSocketDatagramBatch = 64;
+#endif
+
+int SocketIP::SendDatagrams(Datagram* datagrams, int count)
+	{
+    ClearError();
+    for (int i = 0; i < count; ++i)
+        datagrams[i].sent = false;
+    if (! iIsOpen)
+        {
+        iLastError = "Socket wasn't open";
+        return 0;
+        }
+
+	int numSent = 0;
+	int idx = 0;
+#ifdef OS_LINUX
+	struct mmsghdr msgs[kSocketDatagramBatch];
+	struct iovec   iovs[kSocketDatagramBatch];
+	while (idx < count)
+		{
+		int batchLen = min(count - idx, kSocketDatagramBatch);
+		memset(msgs, 0, batchLen * sizeof(msgs[0]));
+		for (int i = 0; i < batchLen; ++i)
+			{
+			Datagram& dg = datagrams[idx + i];
+			iovs[i].iov_base = const_cast<void*>(dg.ptr);
+			iovs[i].iov_len  = dg.len;
+			msgs[i].msg_hdr.msg_name    = const_cast<sockaddr*>(dg.addr->GetStruct());
+			msgs[i].msg_hdr.msg_namelen = dg.addr->GetStructSize();
+			msgs[i].msg_hdr.msg_iov     = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen  = 1;
+			}
+		int status = sendmmsg(iSocket, msgs, batchLen, 0);
+		if (status <= 0)
+			{
+			// Send this one by itself so the error is reported and skipped
+			if (SendOneDatagram(iSocket, &datagrams[idx], &iLastError)) ++numSent;
+			++idx;
+			continue;
+			}
+		for (int i = 0; i < status; ++i)
+			{
+			Datagram& dg = datagrams[idx + i];
+			dg.sent = ((int) msgs[i].msg_len == dg.len);
+			if (dg.sent)
+				++numSent;
+			else
+				iLastError = "Partial write to " + dg.addr->GetString();
+			}
+		idx += status;
+		}
+#endif // OS_LINUX
+
+	for (; idx < count; ++idx)
+		if (SendOneDatagram(iSocket, &datagrams[idx], &iLastError)) ++numSent;
+	return numSent;
+	}
+
 //--------------------------------------------------
 // SocketUDPServer
 //--------------------------------------------------
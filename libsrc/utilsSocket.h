@@ -77,8 +77,18 @@ class SocketIP : public Socket
 		struct Buffer {const void* ptr; int len; Buffer(const void* ptrArg = NULL, int lenArg = 0) : ptr(ptrArg), len(lenArg) {}};
 		bool	MultiWrite  (const Buffer* buffers, int count);
 
+		// Sends each datagram to its own address, ignoring the socket's address. Uses sendmmsg where available so
+		// many datagrams cost only a few system calls. Sets sent on each datagram and returns the number sent.
+		// If any fail, the last error is kept in GetLastError.
+		struct Datagram {const void* ptr; int len; const SockAddr* addr; bool sent;
+		                 Datagram(const void* ptrArg = NULL, int lenArg = 0, const SockAddr* addrArg = NULL) : ptr(ptrArg), len(lenArg), addr(addrArg), sent(false) {}};
+		int		SendDatagrams(Datagram* datagrams, int count);
+
 		// Returns true when the socket has data. Returns false if an error or a timeout occurs.	   
 		bool    HasData     (int timeoutInMS = kInfinite); 
+		// Waits until any of the sockets has data and sets hasData[i] for each one that does.
+		// Returns the number with data, 0 on a timeout or -1 on an error (including an interrupted wait).
+		static int WaitForData(SocketIP* const* sockets, int count, bool* hasData, int timeoutInMS = kInfinite);
 
 		// Discards everything that's in the receive queue
 		bool    Discard     ();
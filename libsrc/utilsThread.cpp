@@ -0,0 +1,215 @@
+// Portable threads and synchronization (pthreads or Win32)
+//
+
+#include "utilsThread.h"
+
+#ifdef OS_WINDOWS
+//----------------------------------------------------------------------------
+// Windows
+//----------------------------------------------------------------------------
+
+Mutex::Mutex()          {InitializeCriticalSection(&iMutex);}
+Mutex::~Mutex()         {DeleteCriticalSection(&iMutex);}
+void Mutex::Lock()      {EnterCriticalSection(&iMutex);}
+void Mutex::Unlock()    {LeaveCriticalSection(&iMutex);}
+
+Condition::Condition()              {InitializeConditionVariable(&iCondition);}
+Condition::~Condition()             {}
+void Condition::Wait(Mutex& mutex)  {SleepConditionVariableCS(&iCondition, &mutex.iMutex, INFINITE);}
+void Condition::Signal()            {WakeConditionVariable(&iCondition);}
+void Condition::Broadcast()         {WakeAllConditionVariable(&iCondition);}
+
+DWORD WINAPI Thread::ThreadEntry(LPVOID arg) {
+    ((Thread*) arg)->Run();
+    return 0;
+}
+
+bool Thread::Start() {
+    if (iIsRunning) return true;
+    iThread = CreateThread(NULL, 0, ThreadEntry, this, 0, NULL);
+    iIsRunning = (iThread != NULL);
+    return iIsRunning;
+}
+
+void Thread::Join() {
+    if (! iIsRunning) return;
+    WaitForSingleObject(iThread, INFINITE);
+    CloseHandle(iThread);
+    iIsRunning = false;
+}
+
+#else
+//----------------------------------------------------------------------------
+// Linux and Mac
+//----------------------------------------------------------------------------
+
+Mutex::Mutex()          {pthread_mutex_init(&iMutex, NULL);}
+Mutex::~Mutex()         {pthread_mutex_destroy(&iMutex);}
+void Mutex::Lock()      {pthread_mutex_lock(&iMutex);}
+void Mutex::Unlock()    {pthread_mutex_unlock(&iMutex);}
+
+Condition::Condition()              {pthread_cond_init(&iCondition, NULL);}
+Condition::~Condition()             {pthread_cond_destroy(&iCondition);}
+void Condition::Wait(Mutex& mutex)  {pthread_cond_wait(&iCondition, &mutex.iMutex);}
+void Condition::Signal()            {pthread_cond_signal(&iCondition);}
+void Condition::Broadcast()         {pthread_cond_broadcast(&iCondition);}
+
+void* Thread::ThreadEntry(void* arg) {
+    ((Thread*) arg)->Run();
+    return NULL;
+}
+
+bool Thread::Start() {
+    if (iIsRunning) return true;
+    iIsRunning = (pthread_create(&iThread, NULL, ThreadEntry, this) == 0);
+    return iIsRunning;
+}
+
+void Thread::Join() {
+    if (! iIsRunning) return;
+    pthread_join(iThread, NULL);
+    iIsRunning = false;
+}
+
+#endif
+
+Thread::~Thread() {
+    Join();
+}
+
+//----------------------------------------------------------------------------
+// Atomic operations and processor count
+//----------------------------------------------------------------------------
+#if defined(OS_WINDOWS)
+
+int AtomicAdd(volatile int* val, int amount) {
+    return InterlockedExchangeAdd((volatile LONG*) val, amount) + amount;
+}
+
+bool AtomicCompareAndSwap(volatile int* val, int oldValue, int newValue) {
+    return InterlockedCompareExchange((volatile LONG*) val, newValue, oldValue) == oldValue;
+}
+
+int NumberOfProcessors() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#else
+#include <unistd.h>
+
+int AtomicAdd(volatile int* val, int amount) {
+    return __sync_add_and_fetch(val, amount);
+}
+
+bool AtomicCompareAndSwap(volatile int* val, int oldValue, int newValue) {
+    return __sync_bool_compare_and_swap(val, oldValue, newValue);
+}
+
+int NumberOfProcessors() {
+    long num = sysconf(_SC_NPROCESSORS_ONLN);
+    return num > 0 ? (int) num : 1;
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+// Thread pool
+//----------------------------------------------------------------------------
+class ThreadPool::Worker : public Thread
+{
+public:
+    Worker(ThreadPool* pool, int threadNum) : iPool(pool), iThreadNum(threadNum) {}
+protected:
+    virtual void Run();
+private:
+    ThreadPool* iPool;
+    int         iThreadNum;
+};
+
+void ThreadPool::Worker::Run() {
+    ThreadPool* pool = iPool;
+    int lastGeneration = 0;
+    pool->iMutex.Lock();
+    while (true) {
+        while (pool->iGeneration == lastGeneration && ! pool->iStopRequested)
+            pool->iCondition.Wait(pool->iMutex);
+        if (pool->iStopRequested) break;
+        lastGeneration = pool->iGeneration;
+        pool->iMutex.Unlock();
+
+        pool->DoWork(iThreadNum);
+
+        pool->iMutex.Lock();
+        if (--pool->iNumActive == 0)
+            pool->iCondition.Broadcast();
+    }
+    pool->iMutex.Unlock();
+}
+
+ThreadPool::ThreadPool(int numThreads) : iInUse(0), iGeneration(0), iCount(0), iFcn(NULL), iInfo(NULL),
+    iStaticSchedule(false), iNextIdx(0), iNumActive(0), iStopRequested(false)
+{
+    for (int i = 1; i < numThreads; ++i) {
+        Worker* worker = new Worker(this, i);
+        if (! worker->Start()) {
+            delete worker;
+            break;
+        }
+        iWorkers.push_back(worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    iMutex.Lock();
+    iStopRequested = true;
+    iCondition.Broadcast();
+    iMutex.Unlock();
+    for (size_t i = 0; i < iWorkers.size(); ++i) {
+        iWorkers[i]->Join();
+        delete iWorkers[i];
+    }
+}
+
+void ThreadPool::DoWork(int threadNum) {
+    if (iStaticSchedule) {
+        int numThreads = GetNumThreads();
+        int start = (int) ((long long) iCount * threadNum / numThreads);
+        int end   = (int) ((long long) iCount * (threadNum + 1) / numThreads);
+        for (int i = start; i < end; ++i)
+            iFcn(i, iInfo);
+    } else {
+        int i;
+        while ((i = AtomicAdd(&iNextIdx, 1) - 1) < iCount)
+            iFcn(i, iInfo);
+    }
+}
+
+void ThreadPool::ParallelFor(int count, LoopFcn_t fcn, void* info, bool staticSchedule) {
+    if (count <= 0) return;
+    if (iWorkers.empty() || count == 1 || ! AtomicCompareAndSwap(&iInUse, 0, 1)) {
+        for (int i = 0; i < count; ++i)
+            fcn(i, info);
+        return;
+    }
+
+    iMutex.Lock();
+    iCount          = count;
+    iFcn            = fcn;
+    iInfo           = info;
+    iStaticSchedule = staticSchedule;
+    iNextIdx        = 0;
+    iNumActive      = iWorkers.size();
+    ++iGeneration;
+    iCondition.Broadcast();
+    iMutex.Unlock();
+
+    DoWork(0);
+
+    iMutex.Lock();
+    while (iNumActive > 0)
+        iCondition.Wait(iMutex);
+    iMutex.Unlock();
+    AtomicAdd(&iInUse, -1);
+}
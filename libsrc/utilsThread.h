@@ -0,0 +1,156 @@
+// Portable threads and synchronization (pthreads or Win32)
+//
+
+#ifndef UTILSTHREAD_H_INCLUDED
+#define UTILSTHREAD_H_INCLUDED
+
+#include "utils.h"
+#include <vector>
+
+#ifdef OS_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+//----------------------------------------------------------------------------
+// Mutex
+//----------------------------------------------------------------------------
+class Mutex
+{
+public:
+    Mutex();
+    ~Mutex();
+    void Lock();
+    void Unlock();
+
+private:
+    friend class Condition;
+#ifdef OS_WINDOWS
+    CRITICAL_SECTION    iMutex;
+#else
+    pthread_mutex_t     iMutex;
+#endif
+    // Don't allow copying
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+};
+
+// Holds the mutex for the lifetime of the object
+class MutexLock
+{
+public:
+    MutexLock(Mutex& mutex) : iMutex(mutex) {iMutex.Lock();}
+    ~MutexLock() {iMutex.Unlock();}
+
+private:
+    Mutex& iMutex;
+    // Don't allow copying
+    MutexLock(const MutexLock&);
+    MutexLock& operator=(const MutexLock&);
+};
+
+//----------------------------------------------------------------------------
+// Condition variable
+//----------------------------------------------------------------------------
+class Condition
+{
+public:
+    Condition();
+    ~Condition();
+    void Wait(Mutex& mutex);    // The mutex must be locked. It's released while waiting.
+    void Signal();              // Wakes one waiter
+    void Broadcast();           // Wakes all waiters
+
+private:
+#ifdef OS_WINDOWS
+    CONDITION_VARIABLE  iCondition;
+#else
+    pthread_cond_t      iCondition;
+#endif
+    // Don't allow copying
+    Condition(const Condition&);
+    Condition& operator=(const Condition&);
+};
+
+//----------------------------------------------------------------------------
+// Thread
+//----------------------------------------------------------------------------
+// Derive from this class and supply Run
+class Thread
+{
+public:
+    Thread() : iIsRunning(false) {}
+    virtual ~Thread();          // The thread must have been joined before it's destroyed
+
+    bool    Start();            // Returns false if the thread couldn't be created
+    void    Join();             // Waits for Run to return
+    bool    IsRunning() const   {return iIsRunning;}
+
+protected:
+    virtual void Run() = 0;
+
+private:
+    bool    iIsRunning;
+#ifdef OS_WINDOWS
+    HANDLE      iThread;
+    static DWORD WINAPI ThreadEntry(LPVOID arg);
+#else
+    pthread_t   iThread;
+    static void* ThreadEntry(void* arg);
+#endif
+    // Don't allow copying
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+};
+
+//----------------------------------------------------------------------------
+// Atomic operations and processor count
+//----------------------------------------------------------------------------
+int AtomicAdd(volatile int* val, int amount);               // Returns the new value
+bool AtomicCompareAndSwap(volatile int* val, int oldValue, int newValue); // Returns true if val was oldValue and is now newValue
+int NumberOfProcessors();
+
+//----------------------------------------------------------------------------
+// Thread pool
+//----------------------------------------------------------------------------
+// A fixed set of worker threads for splitting a loop across processors
+class ThreadPool
+{
+public:
+    typedef void (*LoopFcn_t) (int idx, void* info);
+
+    ThreadPool(int numThreads);    // numThreads includes the thread calling ParallelFor
+    ~ThreadPool();
+    int     GetNumThreads() const  {return iWorkers.size() + 1;}
+
+    // Calls fcn(i, info) for every i from 0 to count-1 and returns when they have all finished. The calling thread does
+    // part of the work. Normally each thread takes the next index when it's done with the previous one. With staticSchedule,
+    // the indices are split into one contiguous block per thread and each block is done in order, so the same thread always
+    // handles the same indices. If the pool is already busy (e.g., ParallelFor was called from within fcn) the loop is run serially.
+    void    ParallelFor(int count, LoopFcn_t fcn, void* info, bool staticSchedule = false);
+
+private:
+    class Worker;
+    friend class Worker;
+    vector<Worker*>     iWorkers;
+    Mutex               iMutex;
+    Condition           iCondition;
+    volatile int        iInUse;         // Set while a ParallelFor is running
+    // The current loop
+    int                 iGeneration;    // Incremented for each loop
+    int                 iCount;
+    LoopFcn_t           iFcn;
+    void*               iInfo;
+    bool                iStaticSchedule;
+    volatile int        iNextIdx;
+    int                 iNumActive;     // Number of workers still working on the current loop
+    bool                iStopRequested;
+
+    void    DoWork(int threadNum);
+    // Don't allow copying
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif // UTILSTHREAD_H_INCLUDED
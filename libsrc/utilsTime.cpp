@@ -32,6 +32,16 @@ void SleepSec(float secs) {
     SleepMilli(secs * 1000);
 }
 
+// Does the OS-specific part of SleepUntilMicro
+void SleepUntilMicroOS(Micro_t deadline);
+
+void SleepUntilMicro(Micro_t deadline, Micro_t spinMicros) {
+    if (MicroUntil(deadline) > (int32) spinMicros)
+        SleepUntilMicroOS(deadline - spinMicros);
+    while (MicroUntil(deadline) > 0)
+        ;
+}
+
 //-------------------------------------------------------------
 // OS-Specific Sleep Functions
 //-------------------------------------------------------------
@@ -49,6 +59,11 @@ void SleepMicro(uint32 microsec) {
     delayMicroseconds(microsec);
 }
 
+void SleepUntilMicroOS(Micro_t deadline) {
+  int32 remaining = MicroUntil(deadline);
+  if (remaining > 0) SleepMicro(remaining);
+}
+
 #elif defined(OS_WINDOWS)
 #include "Windows.h"
 
@@ -62,6 +77,12 @@ void SleepMicro(uint32 microsec) {
   Sleep(1);
 }
 
+// Sleep rounds up to whole milliseconds (or worse), so this wakes up early and leaves the rest to the spin
+void SleepUntilMicroOS(Micro_t deadline) {
+  int32 remaining = MicroUntil(deadline);
+  if (remaining >= 2000) Sleep(remaining / 1000 - 1);
+}
+
 #else // Linux and Mac
 #include <unistd.h>
 
@@ -74,6 +95,31 @@ void SleepMicro(Micro_t microsec) {
   usleep(microsec);
 }
 
+#if defined(OS_LINUX)
+#include <time.h>
+// Converts the deadline to an absolute CLOCK_MONOTONIC time so that being preempted doesn't extend the sleep
+void SleepUntilMicroOS(Micro_t deadline) {
+  struct timespec target;
+  clock_gettime(CLOCK_MONOTONIC, &target);
+  uint32 nowMicros = target.tv_sec * 1000000 + target.tv_nsec / 1000; // Same as Microseconds()
+  int32 remaining = (int32) (deadline - nowMicros);
+  if (remaining <= 0) return;
+  target.tv_sec  += remaining / 1000000;
+  target.tv_nsec += (remaining % 1000000) * 1000;
+  if (target.tv_nsec >= 1000000000) {
+    target.tv_nsec -= 1000000000;
+    ++target.tv_sec;
+  }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) == EINTR)
+    ;
+}
+#else
+void SleepUntilMicroOS(Micro_t deadline) {
+  int32 remaining = MicroUntil(deadline);
+  if (remaining > 0) usleep(remaining);
+}
+#endif
+
 #endif
 
 //-------------------------------------------------------------
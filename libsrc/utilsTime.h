@@ -18,5 +18,11 @@ Micro_t MicroDiff(Micro_t newTime, Micro_t oldTime);
 void SleepSec(float seconds);
 void SleepMilli(Milli_t milliseconds);
 void SleepMicro(Micro_t microseconds);
+// Sleeps until Microseconds() reaches deadline, which may be up to half the clock range in the future. Unlike
+// SleepMicro, time spent before the call doesn't delay the wakeup. The last spinMicros are spent busy waiting,
+// which is more accurate than the OS wakeup.
+void SleepUntilMicro(Micro_t deadline, Micro_t spinMicros = 0);
+// Microseconds until deadline. Negative if it has passed.
+inline int32 MicroUntil(Micro_t deadline) {return (int32) (deadline - Microseconds());}
 
 #endif // _UTILSTIME_H
@@ -7,15 +7,13 @@
 #include "utilsRandom.h"
 #include "utilsOptions.h"
 #include "LFramework.h"
+#include "LSparkle.h"
 #include <iostream>
 #include <stdio.h>
 #include <algorithm> // for min/max
 
-// Configuration
-Milli_t     gFrameDuration  = 40;    // duration of each frame of animation (in MS)
-
-// Fwd decls
-void SetupNextCycle(LobjOld* lobj, Milli_t startTime);
+// Frame length that the firefly speeds were tuned for. Speeds are scaled to match at other frame rates.
+const float kReferenceFrameDuration = 40;
 
 //----------------------------------------------------------------
 // Light Testing
@@ -46,17 +44,23 @@ void TestLights()
 //----------------------------------------------------------------
 // Firefly utilities
 //----------------------------------------------------------------
-Milli_t gTime;
+
+// A firefly wanders randomly and blinks using its sparkle
+class LobjFirefly : public LobjSparkle {
+  public:
+    LobjFirefly(Milli_t currentTime = Milliseconds()) : LobjSparkle(currentTime), maxSpeed(0) {}
+    virtual ~LobjFirefly() {}
+
+    float   maxSpeed;   // Limits the random changes to speed (in positions per second)
+
+    virtual void Clear() {*this = LobjFirefly();}
+    virtual string GetTypeName() const {return "LobjFirefly";}
+};
 
 int MaxFireflies () {
     return max(1, L::gOutput.GetCount() / 20);
 }
 
-// fwd decls
-void FireflyMove(void);
-void FireflyClip(void);
-LobjOld* FireflyAlloc(void);
-
 float RandomBell(float bnum, float mmin = 0.0, float mmax = 1.0) {
     int num = bnum;
     float retval = 0.0;
@@ -67,40 +71,9 @@ float RandomBell(float bnum, float mmin = 0.0, float mmax = 1.0) {
     return retval / bnum;
 }
 
+// In positions per second
 float RandomSpeed() {
-    return L::gRate * RandomBell(2, .005, .4);
-}
-
-LobjOld* FireflyAlloc(void) {
-  LobjOld* lobj = LobjOld::Alloc();
-  if (! lobj) return NULL;
-  lobj->pos = RandomFloat(L::gOutput.GetCount());
-  lobj->speed = RandomSpeed();
-  lobj->velocity = RandomFloat(-lobj->speed, lobj->speed);
-  lobj->maxColor = RandomColor();
-  lobj->color = lobj->maxColor;
-  SetupNextCycle(lobj, gTime);
-  return lobj;
-}
-
-void FireflyMoveOne(LobjOld* lobj) {
-  lobj->pos += lobj->velocity;
-  float delta = RandomBell(2, -lobj->speed/2, lobj->speed/2);
-  lobj->velocity = lobj->velocity + delta;
-}
-
-void FireflyMove(void) {
-  LobjOld::Map(FireflyMoveOne);
-}
-
-void FireflyClip(void) {
-  for (short i = 0; i < LobjOld::GetNum();) {
-    LobjOld* lobj = LobjOld::GetNth(i);
-    if (lobj->pos <= -2 || lobj->pos >= L::gOutput.GetCount() + 1)
-     LobjOld::Free(lobj);
-    else
-     ++i;
-  }
+    return L::gRate * RandomBell(2, .005, .4) * 1000 / kReferenceFrameDuration;
 }
 
 //----------------------------------------------------------------------
@@ -122,85 +95,55 @@ short SmallRandInRange(short minval, short maxval, short factor) {
   return val;
 }
 
-void SetupNextCycle(LobjOld* lobj, Milli_t startTime) {
+LSparkle MakeFireflyCycle(Milli_t startTime) {
+  LSparkle sparkle;
   short attackDur = (RandomInt(150) + 0);
   short holdDur = (RandomInt(attackDur) + RandomInt(attackDur) + attackDur * 2);
   short releaseDur = min(RandomInt(200), RandomInt(200)) + 100;
-  attackDur *= gFFattack;
-  holdDur *= gFFhold;
-  releaseDur *= gFFrelease;
-  short sleepDur = SmallRandInRange(gFFSleepMin, gFFSleepMax, gFFSleepFactor);
-  lobj->startAttack = startTime;
-  lobj->startHold = lobj->startAttack + attackDur;
-  lobj->startRelease = lobj->startHold + holdDur;
-  lobj->startSleep = lobj->startRelease + releaseDur;
-  lobj->startNext = lobj->startSleep + sleepDur;
+  sparkle.startTime = startTime;
+  sparkle.attack    = attackDur * gFFattack;
+  sparkle.hold      = holdDur * gFFhold;
+  sparkle.release   = releaseDur * gFFrelease;
+  sparkle.sleep     = SmallRandInRange(gFFSleepMin, gFFSleepMax, gFFSleepFactor);
+  return sparkle;
 }
 
-void RampColor(LobjOld* lobj, Milli_t startTime, Milli_t endTime, bool reverse) {
-  Milli_t startDiff = gTime - startTime;
-  Milli_t totalDiff = endTime - startTime;
-  if (totalDiff == 0) return;
-  // Scale down so we don't overflow a short
-  while (totalDiff > 127) {
-      startDiff >>= 2;
-      totalDiff >>= 2;
-  }
-  if (reverse) startDiff = totalDiff - startDiff;
-  lobj->color = lobj->maxColor;
-  lobj->color *= startDiff;
-  lobj->color /= totalDiff;
-
-  //cout << "current=" << gTime << "  start=" << startTime << "  end=" << endTime << " startDiff=" << startDiff << " totalDiff=" << totalDiff << endl;
-}
-
-void FireflyDimOne(LobjOld* lobj) {
-  if (gTime < lobj->startHold)
-    RampColor(lobj, lobj->startAttack, lobj->startHold, false);
-  else if (gTime < lobj->startRelease)
-    lobj->color = lobj->maxColor;
-  else if (gTime < lobj->startSleep)
-    RampColor(lobj, lobj->startRelease, lobj->startSleep, true);
-  else if (gTime < lobj->startNext)
-    lobj->color = BLACK;
-  else {
-    SetupNextCycle(lobj, lobj->startNext);
-    RampColor(lobj, lobj->startAttack, max(gTime,lobj->startHold), false);
-  }
+//----------------------------------------------------------------------
+// Group callback
+//----------------------------------------------------------------------
+// The random parts are all done here so the objects themselves can be updated on any thread
+
+LobjFirefly* FireflyAlloc(void) {
+  LobjFirefly* lobj = new LobjFirefly(L::gTime);
+  lobj->pos.x = RandomFloat(L::gOutput.GetCount());
+  lobj->width = 1;
+  lobj->maxSpeed = RandomSpeed();
+  lobj->speed.x = RandomFloat(-lobj->maxSpeed, lobj->maxSpeed);
+  lobj->color = RandomColor();
+  lobj->sparkle = MakeFireflyCycle(L::gTime);
+  return lobj;
 }
 
-void FireflyDim(void) {
-  LobjOld::Map(FireflyDimOne);
+bool IsOffEnd(Lobj* lobj, const void* ignore) {
+  return lobj->pos.x <= -2 || lobj->pos.x >= L::gOutput.GetCount() + 1;
 }
 
-void FireflyLoop()
-{
-    Milli_t startTime = Milliseconds();
-    Milli_t runTimeMilli = L::gRunTime * 1000 + .5;
-
-    while (true) {
-        gTime = Milliseconds();
-        FireflyMove();
-        FireflyClip();
-        // Maybe allocate
-        short num = LobjOld::GetNum();
-        if (num == 0 || (num < MaxFireflies() && num < LobjOld::GetMaxNum() && RandomInt(10) == 0))
-          FireflyAlloc();
-        FireflyDim();
-        // Render
-        L::gOutput.Clear();
-        LobjOld::RenderAll(&L::gOutput);
-        L::gOutput.Update();
-        // Exit if out of time, else delay until next frame
-        Milli_t currentTime = Milliseconds();
-        if (runTimeMilli != 0 && runTimeMilli < MilliDiff(currentTime, startTime))
-            break;
-        else {
-            Milli_t elapsedSinceFrameStart = MilliDiff(currentTime, gTime);
-            if (gFrameDuration > elapsedSinceFrameStart)
-                SleepMilli(gFrameDuration - elapsedSinceFrameStart);
-        }
-    }
+void FireflyGroupCallback(Lgroup* group) {
+  group->FreeIf(IsOffEnd, NULL, false);
+
+  // Maybe allocate
+  int num = group->GetCount();
+  if (num == 0 || (num < MaxFireflies() && RandomInt(10) == 0))
+    group->Add(FireflyAlloc());
+
+  // Wander and start new blinks. The speed changes are scaled so they match the original per-frame changes.
+  float frameScale = L::gFrameDuration / kReferenceFrameDuration;
+  for (Lgroup::iterator i = group->begin(); i != group->end(); ++i) {
+    LobjFirefly* lobj = static_cast<LobjFirefly*>(*i);
+    lobj->speed.x += RandomBell(2, -lobj->maxSpeed/2, lobj->maxSpeed/2) * frameScale;
+    if (lobj->sparkle.IsOutOfTime(L::gTime))
+      lobj->sparkle = MakeFireflyCycle(L::gTime);
+  }
 }
 
 DefProgramHelp(kPHprogram, "Lfirefly");
@@ -213,5 +156,7 @@ int main(int argc, char** argv)
     // Test everything
     // TestLights();
 
-    FireflyLoop();
+    Lgroup fireflies;
+    L::Run(fireflies, NULL, FireflyGroupCallback);
+    L::Cleanup();
 }
@@ -40,14 +40,14 @@ DefOption(density, DensityCallback, "density", "The fraction of time the lights
 // Initializing and running the lights
 //----------------------------------------------------------------
 
-Color* gColor = new WHITE;      // Always set
-Color* gBlack = new BLACK;
+Color* gColor = new RGBColorObj(WHITE);      // Always set
+Color* gBlack = new RGBColorObj(BLACK);
 
 Milli_t gPeriod;
 Milli_t gLastPeriodStart;
 bool gFlashOn = true;
 
-void FlashGroupCallback(Lgroup* ignore)
+void FlashGroupCallback(LgroupSoA* objects)
 {
   Milli_t timediff = MilliDiff(L::gTime, gLastPeriodStart);
   if (L::gEndTime != 0 && MilliGE(L::gTime + L::gFrameDuration, L::gEndTime))
@@ -62,22 +62,9 @@ void FlashGroupCallback(Lgroup* ignore)
   else if (timediff > gPeriod * gDensity)
     // Off if it's too late in the current cycle
     gFlashOn = false;
-}
 
-void FlashCallback(Lobj* obj)
-{
-  if (gFlashOn)
-    obj->color = *gColor;
-  else
-    obj->color = *gBlack;
-}
-
-Lobj* FlashAlloc(int idx, const void* ignore) 
-{
-  Lobj* obj = new Lobj();
-    obj->pos.x = idx;
-    obj->color = *gColor;
-    return obj;
+  // All of the lights are the same color
+  objects->color.assign(objects->GetCount(), RGBColor(gFlashOn ? *gColor : *gBlack));
 }
 
 
@@ -100,12 +87,15 @@ int main(int argc, char** argv)
 
     gPeriod = gFlashSpeedFactor / L::gRate * 1000.0;
 
-    // Allocate objects
-    Lgroup objects;
-    objects.Add(L::gOutput.GetCount(), FlashAlloc, NULL);
+    // Allocate objects. There's one per light, so they're kept in an array-based group.
+    LgroupSoA objects;
+    int numLights = L::gOutput.GetCount();
+    objects.Resize(numLights);
+    for (int i = 0; i < numLights; ++i)
+        objects.pos[i].x = i;
 
     // Perform
-    L::Run(objects, FlashCallback, FlashGroupCallback);
+    L::Run(objects, NULL, FlashGroupCallback);
     L::Cleanup();
     exit(EXIT_SUCCESS);
 }
@@ -61,6 +61,7 @@ class Limage {
     
     RGBColor GetPixel(int x, int y) const;
     void SetPixel(int x, int y, const RGBColor& color);
+    const RGBColor* GetRow(int y) const {return (iBuffer && y >= 0 && y < iHeight) ? iBuffer + y*iWidth : NULL;}
     //void CopyToBuffer(unsigned char*[3] rgbarray);
     bool ReadFromFileRGB(csref filename, int width, string* errmsg = NULL);
     void Clear();
@@ -188,8 +189,8 @@ void LpovGroup::Callback(Lgroup* group)
     }
     int w = L::gOutput.GetCount();
     if (w > povGroup->Image.GetWidth()) w = povGroup->Image.GetWidth();
-    for (int x = 0; x < w; ++x)
-        L::gOutput.SetColor(x, povGroup->Image.GetPixel(x,povGroup->ImageRow));
+    const RGBColor* row = povGroup->Image.GetRow(povGroup->ImageRow);
+    if (row) L::gOutput.SetRGBs(0, w, row);
     // Setup for next frame
     if (povGroup->FrameCount == povGroup->NumOnFrames) 
       povGroup->ImageRow = (povGroup->ImageRow + 1) % povGroup->Image.GetHeight();
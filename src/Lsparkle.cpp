@@ -12,7 +12,9 @@
 
 LobjSparkle* SparkleAlloc(void) {
     LobjSparkle* lobj = new LobjSparkle();
-    lobj->pos.x = RandomInt(L::gOutput.GetCount());
+    // On a matrix(...) output, sparkles are placed anywhere on it
+    lobj->pos.x = RandomInt(L::gOutput.GetWidth());
+    lobj->pos.y = RandomInt(L::gOutput.GetHeight());
     lobj->color = RandomColor();
     lobj->sparkle = LSparkle::MakeRandomSparkle(L::gTime, L::gSparkleMode, L::gSparkleRate);
     return lobj;
@@ -49,7 +51,7 @@ bool IsTimeToAlloc() {
 void SparkleGlobalCallback(Lgroup* objgroup)
 {
     // Deallocate and Allocate
-    objgroup->FreeIf(HasNoSparkleLeft, NULL);
+    objgroup->FreeIf(HasNoSparkleLeft, NULL, false); // Sparkles add, so their order doesn't matter
     if (IsTimeToAlloc())
         objgroup->Add(SparkleAlloc());
 }
@@ -69,6 +71,7 @@ int main(int argc, char** argv)
 
     Lgroup objs;
     L::Startup(&argc, argv);
+    objs.Set2D(L::gOutput.GetHeight() > 1);
     L::Run(objs, NULL, SparkleGlobalCallback);
     L::Cleanup();
 }
@@ -36,32 +36,28 @@ DefOption(density, DensityCallback, "density", "controls the density of stars.",
 // Initialization
 //----------------------------------------------------------------
 
-void InitializeOneStar(LobjSparkle* lobj, int idx, bool firstTime = false) {
-    *lobj = LobjSparkle(L::gTime);
-    lobj->pos.x = idx;
-    lobj->color = (RandomFloat() < gDensity) ? RandomColor() : BLACK;
-    lobj->sparkle = LSparkle::MakeRandomSparkle(L::gTime, L::gSparkleMode, L::gSparkleRate, firstTime);
+// There's one star per light, so they're kept in an array-based group
+LgroupSparkle gObjs;
+
+void InitializeOneStar(int idx, bool firstTime = false) {
+    gObjs.pos[idx]      = Lxy(idx, 0);
+    gObjs.color[idx]    = (RandomFloat() < gDensity) ? RandomColor() : BLACK;
+    gObjs.SetSparkle(idx, LSparkle::MakeRandomSparkle(L::gTime, L::gSparkleMode, L::gSparkleRate, firstTime));
+    gObjs.lastTime[idx] = L::gTime;
 }
 
-const void* kIsFirstTime = (void*) -1;
-
-Lobj* SparkleAlloc(int idx, const void* ignore) {
-    LobjSparkle* lobj = new LobjSparkle(L::gTime);
-    InitializeOneStar(lobj, idx, true);
-    return lobj;
-}
-
-Lgroup gObjs;
-
 void InitializeStars() {
     int numLights = L::gOutput.GetCount();
-    gObjs.Add(numLights, SparkleAlloc, NULL);
+    gObjs.Resize(numLights);
+    for (int i = 0; i < numLights; ++i)
+        InitializeOneStar(i, true);
     }
 
-void StarryCallback(Lobj* objarg) {
-    LobjSparkle* obj = dynamic_cast<LobjSparkle*>(objarg);
-    if (obj->sparkle.IsOutOfTime(obj->nextTime))
-        InitializeOneStar(obj, obj->pos.x);
+void StarryCallback(LgroupSoA* ignore) {
+    int numStars = gObjs.GetCount();
+    for (int i = 0; i < numStars; ++i)
+        if (gObjs.GetSparkle(i).IsOutOfTime(L::gTime))
+            InitializeOneStar(i);
 }
 
 //----------------------------------------------------------------
@@ -77,7 +73,7 @@ int main(int argc, char** argv)
 
     L::Startup(&argc, argv);
     InitializeStars();
-    L::Run(gObjs, StarryCallback);
+    L::Run(gObjs, NULL, StarryCallback);
     L::Cleanup();
     exit(EXIT_SUCCESS);
 }
@@ -42,7 +42,7 @@ DefProgramHelp(kPHhelp, "command is one of:\n"
 //----------------------------------------------
 // Setting up the light pattern
 //----------------------------------------------
-Color* gColor  = new WHITE;  // Always set
+Color* gColor  = new RGBColorObj(WHITE);  // Always set
 Color* gColor2 = NULL;     // Only set if we're doing a color wash
 const int kOneLight  = 0;
 const int kAll       = -1;
@@ -55,8 +55,7 @@ void LtoolCallback(Lgroup* group) {
   int count = L::gOutput.GetCount();
   switch (gIndex) {
     case kAll:
-      for (int i = 0; i < L::gOutput.GetCount(); ++i)
-        L::gOutput.SetRGB(i, *gColor);
+      L::gOutput.SetAll(*gColor);
       break;
     case kWash: {
       HSVColorRange range(*gColor, *gColor2);
@@ -67,8 +66,8 @@ void LtoolCallback(Lgroup* group) {
       L::gOutput.SetRGB(count-1, *gColor);
       break;
     case kPlane:
-      for (int i = 0; i < count; ++i)
-        L::gOutput.SetRGB(i, (i < count / 2) ? *gColor : *gColor2);
+      L::gOutput.FillRGB(0, count / 2, *gColor);
+      L::gOutput.FillRGB(count / 2, count - count / 2, *gColor2);
       break;
     default:
       // Just one pixel
@@ -82,7 +81,7 @@ void ToolSetup(csref command, cvsref params) {
   // *** Check the number of parameters and set up the colors ***
   if (command == "clear") {
     ValidateNumArgs(command, params, 0, 0);
-    gColor = new BLACK;
+    gColor = new RGBColorObj(BLACK);
     gIndex = kAll;
   } 
   else if (command == "set") {
@@ -99,7 +98,7 @@ void ToolSetup(csref command, cvsref params) {
   else if (command == "wash" || command == "rotwash" || command == "bouncewash") {
     int maxArgs = (command == "bouncewash") ? 4 : 2;
     ValidateNumArgs(command, params, 0, maxArgs, true);
-    gColor = new RED; 
+    gColor = new RGBColorObj(RED); 
     if (! ParseOptionalParam(&gColor, params, 0, "color1", &errmsg)) L::ErrorExit(errmsg);
     gColor2 = gColor;
     if (! ParseOptionalParam(&gColor2, params, 1, "color1", &errmsg)) L::ErrorExit(errmsg);
@@ -107,8 +106,8 @@ void ToolSetup(csref command, cvsref params) {
   } 
   else if (command == "plane") {
     ValidateNumArgs(command, params, 0, 0);
-    gColor  = new RED;
-    gColor2 = new GREEN;
+    gColor  = new RGBColorObj(RED);
+    gColor2 = new RGBColorObj(GREEN);
     gIndex = kPlane;
   }
   else 
@@ -0,0 +1,494 @@
+// Emulates ColorKinetics power supplies on local addresses so CKbuffer, ckauto and ckinfo can be tested
+// and benchmarked without hardware. Reports the frames each port receives.
+
+#include "utils.h"
+#include "utilsTime.h"
+#include "utilsSocket.h"
+#include "utilsOptions.h"
+#include "utilsParse.h"
+#include "CKdevice.h"
+#include "KiNET.h"
+#include "LFramework.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+DefProgramHelp(kPHprogram, "ckemu");
+DefProgramHelp(kPHusage, "Emulates ColorKinetics power supplies and reports the frames they receive.");
+DefProgramHelp(kPHadditionalArgs, "supply...");
+DefProgramHelp(kPHhelp, "Each supply is ipaddr(count1,count2,...) with the number of lights on each port. Append *N for\n"
+    "N supplies at consecutive addresses. Put /v1 after the address for a KiNet v1 supply (one count).\n"
+    "  Example: ckemu 127.0.0.2(50,50)*10 127.0.0.20/v1(170)\n"
+    "All of 127.x.x.x is local on Linux. Elsewhere, add loopback aliases first.\n"
+    "Use --ckbroadcast with the --discover address to make ckauto and ckinfo find the supplies.\n"
+    "--time sets how long to run (default is forever).");
+
+//-----------------------------------------------------------------------------------
+// Options
+//-----------------------------------------------------------------------------------
+IPAddr  gDiscoverAddress("127.0.0.1");  // Answers discovery and broadcast PortOutSyncs for every supply
+float   gReportInterval = 1.0;          // Seconds
+
+string DiscoverDefaultCallback(csref name) {
+    return gDiscoverAddress.GetString();
+    }
+
+string DiscoverCallback(csref name, csref val) {
+    IPAddr addr(val);
+    if (! addr.IsValid())
+        return "The --" + name + " parameter, " + val + ", was not an IP address.";
+    gDiscoverAddress = addr;
+    return "";
+}
+
+DefOption(discover, DiscoverCallback, "ipaddr", "sets the address that answers discovery for all of the supplies.", DiscoverDefaultCallback);
+
+string ReportDefaultCallback(csref name) {
+    return FltToStr(gReportInterval);
+    }
+
+string ReportCallback(csref name, csref val) {
+    if (! StrToFlt(val, &gReportInterval))
+        return "The --" + name + " parameter, " + val + ", was not a number.";
+    if (gReportInterval <= 0)
+        return "--" + name + " must be greater than zero.";
+    return "";
+}
+
+DefOption(report, ReportCallback, "seconds", "sets how often the statistics are printed.", ReportDefaultCallback);
+
+//-----------------------------------------------------------------------------------
+// Emulated supplies
+//-----------------------------------------------------------------------------------
+const int kMaxLightsPerPort = 512;
+const int kMaxV1Lights      = 170;  // One DMX universe
+
+// FNV-1a
+uint32 Checksum(const unsigned char* data, int len) {
+    uint32 hash = 2166136261u;
+    for (int i = 0; i < len; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+// A port and the frames it received during the current report
+struct EmuPort {
+    EmuPort(int portArg = 1, int countArg = 0) : port(portArg), count(countArg), lastShown(0), hasShown(false),
+        checksum(0), hasPending(false), pendingChecksum(0), numFrames(0), numChanges(0), totalFrames(0), totalGaps(0) {}
+    int             port;
+    int             count;
+    Micro_t         lastShown;
+    bool            hasShown;
+    uint32          checksum;           // Of the payload being shown
+    // With the sync flag, the payload waits until a PortOutSync
+    bool            hasPending;
+    uint32          pendingChecksum;
+    // For this report
+    int             numFrames;
+    int             numChanges;         // Frames with a different payload than the one before
+    vector<float>   intervals;          // Milliseconds between frames
+    // For the whole run
+    int             totalFrames;
+    int             totalGaps;
+
+    void Show(uint32 newChecksum);
+    void Latch()    {if (hasPending) {hasPending = false; Show(pendingChecksum);}}
+};
+
+void EmuPort::Show(uint32 newChecksum) {
+    Micro_t now = Microseconds();
+    if (hasShown)
+        intervals.push_back(MicroDiff(now, lastShown) / 1000.0);
+    if (! hasShown || newChecksum != checksum) ++numChanges;
+    hasShown = true;
+    lastShown = now;
+    checksum = newChecksum;
+    ++numFrames;
+    ++totalFrames;
+}
+
+struct EmuSupply {
+    EmuSupply() : kinetVersion(2), serial(0), socket(NULL) {}
+    IPAddr              ip;
+    int                 kinetVersion;
+    uint32              serial;
+    vector<EmuPort>     ports;
+    SocketUDPServer*    socket;
+
+    EmuPort*    FindPort(int port);
+    void        Latch() {for (size_t i = 0; i < ports.size(); ++i) ports[i].Latch();}
+};
+
+EmuPort* EmuSupply::FindPort(int port) {
+    for (size_t i = 0; i < ports.size(); ++i)
+        if (ports[i].port == port) return &ports[i];
+    return NULL;
+}
+
+vector<EmuSupply>   gSupplies;
+SocketUDPServer     gDiscoverSocket;
+int                 gNumSyncs = 0;
+int                 gNumBadPackets = 0;
+
+// Parses ipaddr[/v1](count,...)[*N] and adds the supplies
+string AddSupplies(csref spec) {
+    size_t lparen = spec.find('(');
+    size_t rparen = spec.rfind(')');
+    if (lparen == string::npos || rparen == string::npos || rparen < lparen)
+        return "Expected ipaddr(count,...) but got " + spec;
+
+    string addrStr = TrimWhitespace(spec.substr(0, lparen));
+    int kinetVersion = 2;
+    size_t slash = addrStr.find('/');
+    if (slash != string::npos) {
+        if (! StrEQ(addrStr.substr(slash + 1), "v1"))
+            return "Unknown supply type in " + spec + ". Only /v1 is allowed.";
+        kinetVersion = 1;
+        addrStr = addrStr.substr(0, slash);
+    }
+    IPAddr ip(addrStr);
+    if (! ip.IsValid())
+        return "Invalid IP address in " + spec;
+
+    string errmsg;
+    vector<string> countStrs = ParamListFromString(spec.substr(lparen + 1, rparen - lparen - 1), spec, &errmsg);
+    if (countStrs.empty())
+        return errmsg.empty() ? "Missing light counts in " + spec : errmsg;
+    if (kinetVersion == 1 && countStrs.size() != 1)
+        return "KiNet v1 supplies have one light count: " + spec;
+
+    int numSupplies = 1;
+    string rest = TrimWhitespace(spec.substr(rparen + 1));
+    if (! rest.empty() && (rest[0] != '*' || ! StrToInt(rest.substr(1), &numSupplies) || numSupplies < 1))
+        return "Expected *N after the light counts in " + spec;
+
+    EmuSupply supply;
+    supply.kinetVersion = kinetVersion;
+    for (size_t i = 0; i < countStrs.size(); ++i) {
+        int count;
+        int maxCount = (kinetVersion == 1) ? kMaxV1Lights : kMaxLightsPerPort;
+        if (! StrToInt(countStrs[i], &count) || count < 1 || count > maxCount)
+            return "Light counts must be from 1 to " + IntToStr(maxCount) + ": " + spec;
+        supply.ports.push_back(EmuPort(kinetVersion == 1 ? 0 : i + 1, count));
+    }
+
+    for (int i = 0; i < numSupplies; ++i) {
+        supply.ip = IPAddr(ip.GetIP() + i);
+        supply.serial = gSupplies.size() + 1;
+        gSupplies.push_back(supply);
+    }
+    return "";
+}
+
+//-----------------------------------------------------------------------------------
+// Replies
+//-----------------------------------------------------------------------------------
+void SendReply(SocketIP* socket, const void* packet, int len, const SockAddr& dest) {
+    SocketIP::Datagram datagram(packet, len, &dest);
+    if (socket->SendDatagrams(&datagram, 1) != 1)
+        cerr << "Reply to " << dest.GetString() << " failed: " << socket->GetLastError() << endl;
+}
+
+void SendDiscoverReply(SocketIP* socket, const EmuSupply& supply, const SockAddr& dest) {
+    unsigned char packet[256];
+    KiNETdiscoverReply reply;
+    reply.ip = htonl(supply.ip.GetIP());
+    reply.mac[0] = 0x00; reply.mac[1] = 0x0A; reply.mac[2] = 0xC5;
+    reply.mac[3] = (supply.serial >> 16) & 0xFF; reply.mac[4] = (supply.serial >> 8) & 0xFF; reply.mac[5] = supply.serial & 0xFF;
+    reply.kinetVersion = supply.kinetVersion;
+    reply.serial = supply.serial;
+    reply.universe = 0;
+    memcpy(packet, &reply, reply.GetSize());
+
+    // Followed by the info and name strings, each null terminated
+    string info = "M:Color Kinetics Incorporated\nD:ckemu\n#:EMU-" + IntToStr(supply.serial) + "\nR:01\n";
+    string name = "ckemu-" + IntToStr(supply.serial);
+    int len = reply.GetSize();
+    memcpy(packet + len, info.c_str(), info.size() + 1);
+    len += info.size() + 1;
+    memcpy(packet + len, name.c_str(), name.size() + 1);
+    len += name.size() + 1;
+    SendReply(socket, packet, len, dest);
+}
+
+void SendBlinkScanReplies(const EmuSupply& supply, const SockAddr& dest) {
+    if (supply.kinetVersion == 1) {
+        KiNETblinkScan1CAReply reply;
+        int count = supply.ports[0].count;
+        for (int i = 0; i < 4; ++i) {
+            reply.counts[i] = min(count, 255);
+            count -= reply.counts[i];
+        }
+        SendReply(supply.socket, &reply, reply.GetSize(), dest);
+        return;
+    }
+
+    // v2: a start reply, the port data and an end reply
+    unsigned char packet[1024];
+    const uint32 zero = 0;
+    KiNETblinkScan2Reply reply;
+    reply.replyType = KiNETblinkScan2Reply::kStart;
+    memcpy(packet, &reply, reply.GetSize());
+    memcpy(packet + reply.GetSize(), &zero, sizeof(zero));
+    SendReply(supply.socket, packet, reply.GetSize() + sizeof(zero), dest);
+
+    reply.replyType = KiNETblinkScan2Reply::kData;
+    memcpy(packet, &reply, reply.GetSize());
+    int len = reply.GetSize();
+    for (size_t i = 0; i < supply.ports.size(); ++i) {
+        KiNETblinkScan2Data data;
+        data.portnum = supply.ports[i].port;
+        data.porttype = CK::kChromasic;
+        data.length = 4;
+        data.zero = 0;
+        data.count = supply.ports[i].count;
+        memcpy(packet + len, &data, sizeof(data));
+        len += sizeof(data);
+    }
+    SendReply(supply.socket, packet, len, dest);
+
+    reply.replyType = KiNETblinkScan2Reply::kEnd;
+    memcpy(packet, &reply, reply.GetSize());
+    memcpy(packet + reply.GetSize(), &zero, sizeof(zero));
+    SendReply(supply.socket, packet, reply.GetSize() + sizeof(zero), dest);
+}
+
+void SendPortInfoReply(const EmuSupply& supply, const SockAddr& dest) {
+    unsigned char packet[1024];
+    KiNETportInfoReply reply;
+    reply.numPorts = supply.ports.size();
+    memcpy(packet, &reply, reply.GetSize());
+    int len = reply.GetSize();
+    for (size_t i = 0; i < supply.ports.size(); ++i) {
+        KiNETportInfoData data;
+        data.portNum = supply.ports[i].port;
+        data.portType = CK::kChromasic;
+        data.length = 4;
+        data.unused = 0;
+        memcpy(packet + len, &data, sizeof(data));
+        len += sizeof(data);
+    }
+    SendReply(supply.socket, packet, len, dest);
+}
+
+//-----------------------------------------------------------------------------------
+// Handling packets
+//-----------------------------------------------------------------------------------
+// supply is NULL for packets sent to the discovery address
+void HandlePacket(EmuSupply* supply, SocketIP* socket, const unsigned char* buffer, int len, const SockAddr& src) {
+    const KiNETheader* header = (const KiNETheader*) buffer;
+    if (len < (int) sizeof(KiNETheader) || header->magic != KiNETmagic) {
+        ++gNumBadPackets;
+        return;
+    }
+
+    switch (header->type) {
+        case KTYPE_DISCOVER:
+            if (supply)
+                SendDiscoverReply(socket, *supply, src);
+            else
+                for (size_t i = 0; i < gSupplies.size(); ++i)
+                    SendDiscoverReply(socket, gSupplies[i], src);
+            break;
+        case KTYPE_PORTOUT_SYNC:
+            ++gNumSyncs;
+            if (supply)
+                supply->Latch();
+            else
+                for (size_t i = 0; i < gSupplies.size(); ++i)
+                    gSupplies[i].Latch();
+            break;
+        default:
+            if (! supply) {
+                ++gNumBadPackets;
+                break;
+            }
+            if (header->type == KTYPE_BLINK_SCAN1 || header->type == KTYPE_BLINK_SCAN2)
+                SendBlinkScanReplies(*supply, src);
+            else if (header->type == KTYPE_PORT_INFO) {
+                // Like real v1 supplies, don't answer
+                if (supply->kinetVersion == 2)
+                    SendPortInfoReply(*supply, src);
+            }
+            else if (header->type == KTYPE_DMXOUT && supply->kinetVersion == 1 && len >= KiNETdmxOut::GetSize()) {
+                EmuPort& port = supply->ports[0];
+                int payloadLen = min(port.count * 3, len - KiNETdmxOut::GetSize());
+                port.Show(Checksum(buffer + KiNETdmxOut::GetSize(), payloadLen));
+            }
+            else if (header->type == KTYPE_PORTOUT && supply->kinetVersion == 2 && len >= KiNETportOut::GetSize()) {
+                const KiNETportOut* portOut = (const KiNETportOut*) buffer;
+                EmuPort* port = supply->FindPort(portOut->port);
+                int payloadLen = min((int) portOut->len, len - KiNETportOut::GetSize());
+                if (! port) {
+                    ++gNumBadPackets;
+                    break;
+                }
+                uint32 checksum = Checksum(buffer + KiNETportOut::GetSize(), payloadLen);
+                if (portOut->flags & KiNETportOut::kFlagSyncWait) {
+                    port->hasPending = true;
+                    port->pendingChecksum = checksum;
+                } else
+                    port->Show(checksum);
+            }
+            else
+                ++gNumBadPackets;
+            break;
+    }
+}
+
+//-----------------------------------------------------------------------------------
+// Statistics
+//-----------------------------------------------------------------------------------
+// Intervals more than this much longer than the median are counted as gaps (probably dropped frames)
+const float kGapFactor = 1.5;
+
+void Report(float elapsed) {
+    cout << fixed << setprecision(1) << "After " << elapsed << "s:" << endl;
+    for (size_t i = 0; i < gSupplies.size(); ++i) {
+        EmuSupply& supply = gSupplies[i];
+        for (size_t j = 0; j < supply.ports.size(); ++j) {
+            EmuPort& port = supply.ports[j];
+            // Jitter is the standard deviation of the intervals between frames
+            int numGaps = 0;
+            double mean = 0, variance = 0;
+            if (! port.intervals.empty()) {
+                vector<float> sorted = port.intervals;
+                sort(sorted.begin(), sorted.end());
+                float median = sorted[sorted.size() / 2];
+                for (size_t k = 0; k < sorted.size(); ++k) {
+                    mean += sorted[k];
+                    if (sorted[k] > median * kGapFactor) ++numGaps;
+                }
+                mean /= sorted.size();
+                for (size_t k = 0; k < sorted.size(); ++k)
+                    variance += (sorted[k] - mean) * (sorted[k] - mean);
+                variance /= sorted.size();
+            }
+            port.totalGaps += numGaps;
+
+            string name = supply.ip.GetString() + (supply.kinetVersion == 1 ? "" : "/" + IntToStr(port.port));
+            cout << "  " << left << setw(18) << name << right << setw(4) << port.count << " lights "
+                 << setw(6) << port.numFrames / gReportInterval << " fps  "
+                 << setw(4) << port.numChanges << " changed  "
+                 << "jitter " << setprecision(2) << sqrt(variance) << "ms  " << setprecision(1)
+                 << "gaps " << numGaps << "  "
+                 << "checksum " << hex << uppercase << setw(8) << setfill('0') << port.checksum << dec << nouppercase << setfill(' ')
+                 << (port.hasPending ? "  (waiting for sync)" : "") << endl;
+
+            port.numFrames = 0;
+            port.numChanges = 0;
+            port.intervals.clear();
+        }
+    }
+    cout << "  PortOutSyncs: " << gNumSyncs << "  Unexpected packets: " << gNumBadPackets << endl;
+}
+
+void ReportTotals(float elapsed) {
+    cout << fixed << setprecision(1) << "Totals for " << elapsed << "s:" << endl;
+    for (size_t i = 0; i < gSupplies.size(); ++i)
+        for (size_t j = 0; j < gSupplies[i].ports.size(); ++j) {
+            const EmuPort& port = gSupplies[i].ports[j];
+            string name = gSupplies[i].ip.GetString() + (gSupplies[i].kinetVersion == 1 ? "" : "/" + IntToStr(port.port));
+            cout << "  " << left << setw(18) << name << right << setw(7) << port.totalFrames << " frames  "
+                 << setw(6) << (elapsed > 0 ? port.totalFrames / elapsed : 0) << " fps  gaps " << port.totalGaps << endl;
+        }
+}
+
+//-----------------------------------------------------------------------------------
+// Main function
+//-----------------------------------------------------------------------------------
+volatile bool gQuit = false;
+
+bool EmuCtrlCHandler() {
+    gQuit = true;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // Delete unneeded options
+    Option::DeleteOption("rate");
+    Option::DeleteOption("color");
+    Option::ParseArglist(&argc, argv, Option::kVariable);
+    if (argc < 2) {
+        cerr << "ckemu: Specify at least one supply. Use --help for the format." << endl;
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        string errmsg = AddSupplies(argv[i]);
+        if (! errmsg.empty()) {
+            cerr << "ckemu: " << errmsg << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Open the sockets
+    vector<SocketIP*> sockets;
+    if (! gDiscoverSocket.SetSockAddr(gDiscoverAddress, KiNETudpPort)) {
+        cerr << "ckemu: " << gDiscoverSocket.GetLastError() << endl;
+        return EXIT_FAILURE;
+    }
+    sockets.push_back(&gDiscoverSocket);
+    for (size_t i = 0; i < gSupplies.size(); ++i) {
+        gSupplies[i].socket = new SocketUDPServer();
+        if (! gSupplies[i].socket->SetSockAddr(gSupplies[i].ip, KiNETudpPort)) {
+            cerr << "ckemu: " << gSupplies[i].socket->GetLastError() << endl;
+            return EXIT_FAILURE;
+        }
+        sockets.push_back(gSupplies[i].socket);
+    }
+
+    cout << "Emulating " << gSupplies.size() << " supplies. Discovery is at " << gDiscoverAddress.GetString() << endl;
+    cout << "  Devices:";
+    for (size_t i = 0; i < gSupplies.size() && i < 4; ++i)
+        for (size_t j = 0; j < gSupplies[i].ports.size(); ++j) {
+            CKdevice device(gSupplies[i].ip, CK::kAnyUniverse, gSupplies[i].ports[j].port, gSupplies[i].ports[j].count);
+            device.SetKiNetVersion(gSupplies[i].kinetVersion);
+            cout << " " << device.GetDescriptor();
+        }
+    cout << (gSupplies.size() > 4 ? " ..." : "") << endl;
+    cout << "  Use ckauto with: --ckbroadcast " << gDiscoverAddress.GetString() << endl;
+
+    CtrlCHandler::Add(EmuCtrlCHandler);
+    Milli_t startTime = Milliseconds();
+    Milli_t nextReport = startTime + (Milli_t) (gReportInterval * 1000);
+    Milli_t endTime = startTime + (Milli_t) (L::gRunTime * 1000);
+    bool* hasData = new bool[sockets.size()];
+    unsigned char buffer[2048];
+
+    while (! gQuit) {
+        Milli_t now = Milliseconds();
+        if (L::gRunTime > 0 && ! MilliLT(now, endTime)) break;
+        if (! MilliLT(now, nextReport)) {
+            Report(MilliDiff(now, startTime) / 1000.0);
+            nextReport += gReportInterval * 1000;
+            continue;
+        }
+
+        Milli_t wakeTime = (L::gRunTime > 0 && MilliLT(endTime, nextReport)) ? endTime : nextReport;
+        int numReady = SocketIP::WaitForData(&sockets[0], sockets.size(), hasData, MilliDiff(wakeTime, now));
+        if (numReady <= 0) continue;
+        // Broadcast syncs follow the PortOuts of their frame, so the supplies' queued packets are all handled
+        // before the discovery socket. Otherwise a sync could latch one port's new frame and another's old one.
+        for (size_t n = 1; n <= sockets.size(); ++n) {
+            size_t i = n % sockets.size();
+            if (! hasData[i]) continue;
+            EmuSupply* supply = (i == 0) ? NULL : &gSupplies[i - 1];
+            do {
+                SockAddr src;
+                int len = 0;
+                if (! sockets[i]->Read((char*) buffer, sizeof(buffer), &src, &len)) break;
+                HandlePacket(supply, sockets[i], buffer, len, src);
+            } while (supply && sockets[i]->HasData(0));
+        }
+    }
+
+    ReportTotals(MilliDiff(Milliseconds(), startTime) / 1000.0);
+    delete [] hasData;
+    for (size_t i = 0; i < gSupplies.size(); ++i)
+        delete gSupplies[i].socket;
+    return EXIT_SUCCESS;
+}
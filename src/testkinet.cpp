@@ -0,0 +1,114 @@
+// Benchmarks building the KiNET packet for one device each frame
+//
+
+#include "utils.h"
+#include "utilsTime.h"
+#include "utilsRandom.h"
+#include "Color.h"
+#include "ColorQuantize.h"
+#include "CKdevice.h"
+#include "CKbuffer.h"
+#include "KiNET.h"
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+const int kNumIterations = 20000;
+const int kMaxLen = 2048;
+
+// This is how CKbuffer built packets before CKpacket: a new header and (for v1) padding every frame
+// in a stack buffer that was then compared with and copied to the last packet sent.
+int BuildPacketOld(const CKdevice& device, const RGBColor* colors, unsigned char* outbuf)
+{
+	int len = device.GetCount();
+	if (device.GetKiNetVersion() == 2) {
+		KiNETportOut* header = (KiNETportOut*) outbuf;
+		int hdrLen = KiNETportOut::GetSize();
+		QuantizeRGB(colors, len, outbuf + hdrLen);
+		*header = KiNETportOut();
+		header->port = device.GetPort();
+		header->universe = device.GetUniverse();
+		header->len = len * 3;
+		return hdrLen + len * 3;
+	} else {
+		KiNETdmxOut header;
+		int hdrLen = KiNETdmxOut::GetSize();
+		unsigned char* dataPtr = outbuf + hdrLen;
+		QuantizeRGB(colors, len, dataPtr);
+		for (int i = len * 3; i < 512; ++i)
+			dataPtr[i] = 0;
+		header.universe = device.GetUniverse();
+		memcpy(outbuf, &header, hdrLen);
+		return hdrLen + 512;
+	}
+}
+
+// Returns the average time per frame in microseconds
+float TimeOld(const CKdevice& device, const vector<RGBColor>& frame, vector<unsigned char>* lastPacket)
+{
+	unsigned char outbuf[kMaxLen];
+	int numUnchanged = 0;
+	Micro_t startTime = Microseconds();
+	for (int i = 0; i < kNumIterations; ++i) {
+		int len = BuildPacketOld(device, &frame[0], outbuf);
+		if (lastPacket->size() == (size_t) len && memcmp(&(*lastPacket)[0], outbuf, len) == 0)
+			++numUnchanged;
+		lastPacket->assign(outbuf, outbuf + len);
+	}
+	float elapsed = MicroDiff(Microseconds(), startTime);
+	if (numUnchanged == 0) cout << "   (old: no unchanged frames detected)" << endl;
+	return elapsed / kNumIterations;
+}
+
+float TimeNew(const CKdevice& device, const vector<RGBColor>& frame, vector<unsigned char>* lastPacket)
+{
+	CKpacket packets[2];
+	packets[0].Initialize(device);
+	packets[1].Initialize(device);
+	int sent = -1, numUnchanged = 0;
+	Micro_t startTime = Microseconds();
+	for (int i = 0; i < kNumIterations; ++i) {
+		int next = (sent == 0) ? 1 : 0;
+		packets[next].Encode(&frame[0], frame.size());
+		if (sent >= 0 && packets[next].SamePayload(packets[sent]))
+			++numUnchanged;
+		sent = next;
+	}
+	float elapsed = MicroDiff(Microseconds(), startTime);
+	if (numUnchanged == 0) cout << "   (new: no unchanged frames detected)" << endl;
+	lastPacket->assign(packets[sent].GetData(), packets[sent].GetData() + packets[sent].GetLength());
+	return elapsed / kNumIterations;
+}
+
+void TestKiNET(csref descriptor)
+{
+	CKdevice device(descriptor);
+	if (device.HasError()) {
+		cout << descriptor << ": " << device.GetLastError() << endl;
+		return;
+	}
+
+	vector<RGBColor> frame(device.GetCount());
+	for (size_t i = 0; i < frame.size(); ++i)
+		frame[i] = RGBColor(RandomFloat(), RandomFloat(), RandomFloat());
+
+	vector<unsigned char> oldPacket, newPacket;
+	float oldTime = TimeOld(device, frame, &oldPacket);
+	float newTime = TimeNew(device, frame, &newPacket);
+
+	cout << "KiNET v" << device.GetKiNetVersion() << " device with " << device.GetCount() << " lights (" << descriptor << ")" << endl;
+	cout << "   Rebuilt packet: " << oldTime << "us" << endl;
+	cout << "   CKpacket:       " << newTime << "us  [" << oldTime / max(newTime, .001F) << "x faster]" << endl;
+	cout << "   Packets " << (oldPacket == newPacket ? "match" : "DIFFER") << " (" << newPacket.size() << " bytes)" << endl;
+	cout << endl;
+}
+
+int main()
+{
+	RandomInitialize();
+	TestKiNET("10.0.0.1(50)");
+	TestKiNET("10.0.0.1(170)");
+	TestKiNET("10.0.0.1/1(50)");
+	TestKiNET("10.0.0.1/1(256)");
+	return 0;
+}
@@ -0,0 +1,73 @@
+// Benchmarks converting frames of colors to 8-bit device values
+//
+
+#include "utils.h"
+#include "utilsTime.h"
+#include "utilsRandom.h"
+#include "Color.h"
+#include "ColorQuantize.h"
+#include <iostream>
+#include <vector>
+
+const int kNumIterations = 2000;
+
+// This is how the devices converted frames before ColorQuantize
+void QuantizeByChannel(const RGBColor* src, int count, unsigned char* dest)
+{
+	for (int i = 0; i < count; ++i) {
+		*dest++ = src[i].rAsChar();
+		*dest++ = src[i].gAsChar();
+		*dest++ = src[i].bAsChar();
+	}
+}
+
+typedef void (*QuantizeFcn_t)(const RGBColor* src, int count, unsigned char* dest);
+void QuantizeSIMD  (const RGBColor* src, int count, unsigned char* dest) {QuantizeRGB(src, count, dest);}
+void QuantizeScalar(const RGBColor* src, int count, unsigned char* dest) {QuantizeRGBScalar(src, count, dest);}
+
+// Returns the average time per frame in microseconds
+float TimeQuantize(QuantizeFcn_t fcn, const vector<RGBColor>& frame, vector<unsigned char>* bytes)
+{
+	Micro_t startTime = Microseconds();
+	for (int i = 0; i < kNumIterations; ++i)
+		fcn(&frame[0], frame.size(), &(*bytes)[0]);
+	return MicroDiff(Microseconds(), startTime) / (float) kNumIterations;
+}
+
+int CountDifferences(const vector<unsigned char>& a, const vector<unsigned char>& b)
+{
+	int num = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (a[i] != b[i]) ++num;
+	return num;
+}
+
+void TestQuantize(int numPixels)
+{
+	// Include out of range values to exercise the clamping
+	vector<RGBColor> frame(numPixels);
+	for (int i = 0; i < numPixels; ++i)
+		frame[i] = RGBColor(RandomFloat(-.2, 1.2), RandomFloat(-.2, 1.2), RandomFloat(-.2, 1.2));
+
+	vector<unsigned char> byChannel(numPixels * 3), scalar(numPixels * 3), simd(numPixels * 3);
+	float byChannelTime = TimeQuantize(QuantizeByChannel, frame, &byChannel);
+	float scalarTime    = TimeQuantize(QuantizeScalar,    frame, &scalar);
+	float simdTime      = TimeQuantize(QuantizeSIMD,      frame, &simd);
+
+	cout << "Frame of " << numPixels << " pixels" << endl;
+	cout << "   Per channel (rAsChar): " << byChannelTime << "us" << endl;
+	cout << "   QuantizeRGBScalar:     " << scalarTime << "us" << endl;
+	cout << "   QuantizeRGB (" << QuantizeRGBImplementation() << "): " << simdTime << "us  "
+		 << "[" << byChannelTime / max(simdTime, .001F) << "x faster]" << endl;
+	cout << "   Bytes differing from rAsChar: scalar " << CountDifferences(byChannel, scalar)
+		 << ", SIMD " << CountDifferences(byChannel, simd) << endl;
+	cout << endl;
+}
+
+int main()
+{
+	RandomInitialize();
+	TestQuantize(512);
+	TestQuantize(10000);
+	return 0;
+}
@@ -0,0 +1,138 @@
+// Tests and times drawing square objects into a 2D Lframe
+//
+
+#include "utils.h"
+#include "utilsTime.h"
+#include "utilsRandom.h"
+#include "Color.h"
+#include "Lobj.h"
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+const int   kSize = 20;
+const float kEpsilon = 1e-4;
+const int   kNumFrames = 200;
+const int   kNumObjects = 2000;
+
+int gNumFailures = 0;
+
+// The total coverage drawn into the frame, using white objects
+float SumFrame(Lframe* frame)
+{
+	float sum = 0;
+	RGBColor* pixels = frame->GetPixels();
+	for (int i = 0; i < frame->GetCount(); ++i)
+		sum += pixels[i].r;
+	return sum;
+}
+
+float GetPixel(Lframe* frame, int x, int y)
+{
+	return frame->GetPixels()[y * frame->GetWidth() + x].r;
+}
+
+void Check(csref name, bool ok)
+{
+	cout << (ok ? "   ok    " : "   FAIL  ") << name << endl;
+	if (!ok) ++gNumFailures;
+}
+
+bool Near(float a, float b)
+{
+	return fabs(a - b) < kEpsilon;
+}
+
+// Draws one object into an empty frame and checks its total coverage, and optionally one pixel
+void TestObject(csref name, const Lxy& pos, float width, float expectedSum, int x = -1, int y = -1, float expectedPixel = 0)
+{
+	Lframe frame;
+	frame.Clear(kSize, kSize);
+	frame.AddObject(pos, width, WHITE);
+	bool ok = Near(SumFrame(&frame), expectedSum);
+	if (x >= 0)
+		ok = ok && Near(GetPixel(&frame, x, y), expectedPixel);
+	if (!ok)
+		cout << "         sum was " << SumFrame(&frame) << ", expected " << expectedSum << endl;
+	Check(name, ok);
+}
+
+void TestKnownObjects()
+{
+	cout << "Known objects" << endl;
+	gAntiAlias = true;
+	TestObject("centered on a pixel",       Lxy(10, 10),       3,   9,    9, 9, 1);
+	TestObject("half pixel offset in x",    Lxy(10.5, 10),     2,   4,    11, 10, 1);
+	TestObject("half pixel offset in x,y",  Lxy(10.5, 10.5),   1,   1,    10, 10, .25);
+	TestObject("quarter pixel offset",      Lxy(5.25, 7.75),   1.5, 2.25, 6, 7, .25);
+	TestObject("top left edge",             Lxy(0, 0),         3,   4,    0, 0, 1);
+	TestObject("bottom right edge",         Lxy(kSize - 1, kSize - 1), 3, 4, kSize - 1, kSize - 1, 1);
+	TestObject("off the left",              Lxy(-10, 5),       3,   0);
+	TestObject("off the bottom",            Lxy(5, kSize + 10), 3,  0);
+	TestObject("width 0",                   Lxy(10.4, 9.6),    0,   1,    10, 10, 1);
+
+	gAntiAlias = false;
+	TestObject("no anti-alias, rounds up",  Lxy(10, 10),       2.6, 9,    9, 9, 1);
+	TestObject("no anti-alias, off edge",   Lxy(0, 0),         3,   4,    1, 1, 1);
+	TestObject("no anti-alias, off screen", Lxy(-10, -10),     3,   0);
+	gAntiAlias = true;
+	cout << endl;
+}
+
+// Anti-aliased objects that are entirely in the frame should always cover width^2 pixels
+void TestCoverage()
+{
+	cout << "Coverage of random objects" << endl;
+	Lframe frame;
+	int numBad = 0;
+	for (int i = 0; i < 1000; ++i) {
+		float width = RandomFloat(.1, 6);
+		Lxy pos(RandomFloat(width/2, kSize - 1 - width/2), RandomFloat(width/2, kSize - 1 - width/2));
+		frame.Clear(kSize, kSize);
+		frame.AddObject(pos, width, WHITE);
+		if (! Near(SumFrame(&frame), width * width)) {
+			if (numBad++ == 0)
+				cout << "         width " << width << " at " << pos.x << "," << pos.y << " covered " << SumFrame(&frame) << endl;
+		}
+	}
+	Check("coverage sums to width squared", numBad == 0);
+	cout << endl;
+}
+
+// Returns the average time per frame in microseconds
+float TimeRaster(bool antiAlias)
+{
+	vector<Lxy> pos(kNumObjects);
+	vector<float> width(kNumObjects);
+	for (int i = 0; i < kNumObjects; ++i) {
+		pos[i] = Lxy(RandomFloat(-2, 66), RandomFloat(-2, 66));
+		width[i] = RandomFloat(.5, 4);
+	}
+
+	gAntiAlias = antiAlias;
+	Lframe frame;
+	Micro_t startTime = Microseconds();
+	for (int n = 0; n < kNumFrames; ++n) {
+		frame.Clear(64, 64);
+		for (int i = 0; i < kNumObjects; ++i)
+			frame.AddObject(pos[i], width[i], WHITE);
+	}
+	gAntiAlias = true;
+	return MicroDiff(Microseconds(), startTime) / (float) kNumFrames;
+}
+
+int main()
+{
+	RandomInitialize();
+	TestKnownObjects();
+	TestCoverage();
+
+	cout << "64x64 frame of " << kNumObjects << " objects" << endl;
+	cout << "   Anti-aliased: " << TimeRaster(true)  << "us per frame" << endl;
+	cout << "   Snapped:      " << TimeRaster(false) << "us per frame" << endl;
+	cout << endl;
+
+	if (gNumFailures)
+		cout << gNumFailures << " FAILED" << endl;
+	return gNumFailures ? 1 : 0;
+}
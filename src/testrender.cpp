@@ -0,0 +1,88 @@
+// Benchmarks rendering a starry night sized group of sparkles with different numbers of render threads
+//
+
+#include "utils.h"
+#include "utilsTime.h"
+#include "utilsRandom.h"
+#include "utilsThread.h"
+#include "Color.h"
+#include "Lobj.h"
+#include "LSparkle.h"
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+const int kNumFrames = 200;
+const int kFrameDuration = 40;
+
+// Holds the frame in memory instead of sending it anywhere
+class MemoryBuffer : public LBufferPhys
+{
+public:
+	MemoryBuffer(int count) : LBufferPhys(count) {}
+	virtual string GetDescriptor() const {return "memory(" + IntToStr(GetCount()) + ")";}
+	const vector<RGBColor>& GetPixels() const {return iBuffer;}
+protected:
+	virtual bool Transmit(const RGBColor* colors, int count) {return true;}
+};
+
+bool SameFrame(const vector<RGBColor>& a, const vector<RGBColor>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(RGBColor)) == 0);
+}
+
+// Returns the average time per frame in microseconds
+float TimeRender(LgroupSparkle* stars, MemoryBuffer* buffer)
+{
+	Milli_t time = 0;
+	Micro_t startTime = Microseconds();
+	for (int i = 0; i < kNumFrames; ++i) {
+		time += kFrameDuration;
+		buffer->Clear();
+		stars->RenderAll(time, buffer);
+	}
+	return MicroDiff(Microseconds(), startTime) / (float) kNumFrames;
+}
+
+void TestRender(int numStars, const vector<int>& threadCounts)
+{
+	// One star per light, like Lstarry
+	LgroupSparkle stars;
+	stars.Resize(numStars);
+	for (int i = 0; i < numStars; ++i) {
+		stars.pos[i] = Lxy(i, 0);
+		stars.color[i] = RandomColor();
+		stars.SetSparkle(i, LSparkle::MakeRandomSparkle(0, LSparkle::kSlow, 1.0, true));
+		stars.lastTime[i] = 0;
+	}
+	MemoryBuffer buffer(numStars);
+
+	cout << numStars << " stars" << endl;
+	float baseTime = 0;
+	vector<RGBColor> baseFrame;
+	for (size_t i = 0; i < threadCounts.size(); ++i) {
+		gRenderThreads = threadCounts[i];
+		float time = TimeRender(&stars, &buffer);
+		if (i == 0) {
+			baseTime = time;
+			baseFrame = buffer.GetPixels();
+		}
+		cout << "   " << threadCounts[i] << " thread(s): " << time << "us per frame  [" << baseTime / time << "x]"
+		     << (SameFrame(buffer.GetPixels(), baseFrame) ? "" : "  FRAMES DIFFER") << endl;
+	}
+	cout << endl;
+}
+
+int main()
+{
+	RandomInitialize();
+	// The render pool is sized by the first thread count above 1 that's used, so go down from the most
+	vector<int> threadCounts;
+	threadCounts.push_back(1);
+	for (int n = max(NumberOfProcessors(), 4); n > 1; n /= 2)
+		threadCounts.push_back(n);
+	cout << "Processors: " << NumberOfProcessors() << endl << endl;
+	TestRender(2000, threadCounts);
+	TestRender(10000, threadCounts);
+	return 0;
+}